@@ -0,0 +1,170 @@
+/** @file
+  Pomiar przepustowosci kalkulatora wielomianów na skryptach.
+  Uruchamia kalkulator na kazdym skrypcie, liczy bajty, które wypisal,
+  i mierzy czas wykonania oraz szczytowe zuzycie pamieci.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#define _XOPEN_SOURCE 700 ///< aby znalezc potrzebne funkcje
+#define _DEFAULT_SOURCE ///< aby znalezc wait4
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+/**
+Rozmiar bufora do czytania wyjscia kalkulatora i skryptów.
+*/
+#define BUFFER_SIZE 65536
+
+/**
+* Wynik pomiaru jednego skryptu.
+*/
+typedef struct
+{
+    size_t lines; ///< liczba linijek skryptu
+    size_t input_bytes; ///< rozmiar skryptu
+    size_t output_bytes; ///< liczba bajtów wypisanych na standardowe wyjscie
+    double seconds; ///< czas wykonania
+    long peak_rss_kb; ///< szczytowe zuzycie pamieci przez kalkulator
+}   Result;
+
+/**
+* Liczy linijki i bajty skryptu.
+* @param[in] path: sciezka do skryptu
+* @param[out] r: wynik
+* @return czy udalo sie odczytac skrypt
+*/
+static bool CountInput(const char* path, Result* r)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    static char buffer[BUFFER_SIZE];
+    size_t n;
+    bool ends_with_newline = true;
+    r->lines = r->input_bytes = 0;
+    while ((n = fread(buffer, 1, BUFFER_SIZE, f)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            r->lines += (buffer[i] == '\n');
+        }
+        r->input_bytes += n;
+        ends_with_newline = (buffer[n - 1] == '\n');
+    }
+    r->lines += !ends_with_newline;
+    fclose(f);
+    return true;
+}
+
+/**
+* Zwraca biezacy czas monotoniczny w sekundach.
+* @return czas
+*/
+static double Now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+* Uruchamia kalkulator na skrypcie podanym jako argument i mierzy wykonanie.
+* Komunikaty o bledach sa pomijane. Zmienne srodowiskowe, np. POLY_THREADS,
+* sa przekazywane kalkulatorowi.
+* @param[in] poly: sciezka do kalkulatora
+* @param[in] path: sciezka do skryptu
+* @param[out] r: wynik
+* @return czy kalkulator zakonczyl sie poprawnie
+*/
+static bool Run(const char* poly, const char* path, Result* r)
+{
+    int out[2];
+    if (pipe(out) == -1)
+    {
+        return false;
+    }
+    double start = Now();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        return false;
+    }
+    if (pid == 0)
+    {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        close(out[0]);
+        close(out[1]);
+        execl(poly, poly, path, (char*)NULL);
+        _exit(127);
+    }
+    close(out[1]);
+
+    static char buffer[BUFFER_SIZE];
+    ssize_t n;
+    r->output_bytes = 0;
+    while ((n = read(out[0], buffer, BUFFER_SIZE)) > 0)
+    {
+        r->output_bytes += n;
+    }
+    close(out[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == -1)
+    {
+        return false;
+    }
+    r->seconds = Now() - start;
+    r->peak_rss_kb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+* Mierzy kalkulator na kolejnych skryptach i wypisuje wyniki w formacie CSV.
+* Dla skryptu z samymi wielomianami przepustowosc wejscia odpowiada
+* szybkosci parsowania, a dla skryptu z poleceniami PRINT przepustowosc
+* wyjscia odpowiada szybkosci wypisywania.
+* @param[in] argc: liczba argumentów
+* @param[in] argv: sciezka do kalkulatora i sciezki do skryptów
+* @return kod wyjscia programu
+*/
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s poly script...\n", argv[0]);
+        return 1;
+    }
+    printf("script,lines,input_bytes,output_bytes,seconds,lines_per_s,"
+           "input_mb_per_s,output_mb_per_s,peak_rss_kb\n");
+    int result = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        Result r;
+        if (!CountInput(argv[i], &r) || !Run(argv[1], argv[i], &r))
+        {
+            fprintf(stderr, "cannot run %s on %s\n", argv[1], argv[i]);
+            result = 1;
+            continue;
+        }
+        printf("%s,%zu,%zu,%zu,%.3f,%.0f,%.2f,%.2f,%ld\n",
+               argv[i], r.lines, r.input_bytes, r.output_bytes, r.seconds,
+               r.lines / r.seconds, r.input_bytes / r.seconds / 1e6,
+               r.output_bytes / r.seconds / 1e6, r.peak_rss_kb);
+        fflush(stdout);
+    }
+    return result;
+}
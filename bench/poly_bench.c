@@ -0,0 +1,599 @@
+/** @file
+  Mikrobenchmarki biblioteki wielomianów rzadkich wielu zmiennych.
+  Mierzy czas kluczowych operacji na deterministycznie generowanych
+  wielomianach róznych ksztaltów i rozmiarów oraz wypisuje wyniki
+  w formacie CSV lub JSON.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#define _XOPEN_SOURCE 700 ///< aby znalezc potrzebne funkcje
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "poly.h"
+
+/**
+Sprawdza, czy alokacja sie powiodla.
+*/
+#define CHECK_PTR(p)    	\
+	do {			    	\
+		if (p == NULL) {	\
+			exit(1);		\
+		}					\
+	} while (0)
+
+/**
+Domyslny minimalny czas pomiaru jednego przypadku w milisekundach.
+*/
+#define DEFAULT_MIN_TIME_MS 200
+
+/**
+Liczba przydzielen pamieci przez malloc, calloc i realloc. Program jest
+linkowany z opcja --wrap, wiec wywolania tych funkcji w bibliotece
+trafiaja do funkcji __wrap_* zdefiniowanych ponizej.
+*/
+static atomic_size_t allocations = 0;
+
+void* __real_malloc(size_t size); ///< oryginalny malloc
+void* __real_calloc(size_t count, size_t size); ///< oryginalny calloc
+void* __real_realloc(void* ptr, size_t size); ///< oryginalny realloc
+
+/**
+* Przydziela pamiec, zliczajac przydzielenie.
+* @param[in] size: rozmiar
+* @return wskaznik na pamiec
+*/
+void* __wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+/**
+* Przydziela wyzerowana pamiec, zliczajac przydzielenie.
+* @param[in] count: liczba elementów
+* @param[in] size: rozmiar elementu
+* @return wskaznik na pamiec
+*/
+void* __wrap_calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+/**
+* Zmienia rozmiar pamieci, zliczajac przydzielenie.
+* @param[in] ptr: wskaznik na pamiec
+* @param[in] size: nowy rozmiar
+* @return wskaznik na pamiec
+*/
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+/**
+Stan generatora liczb pseudolosowych.
+*/
+static uint64_t random_state;
+
+/**
+* Losuje liczbe generatorem xorshift64*; wyniki zaleza tylko od ziarna.
+* @return liczba pseudolosowa
+*/
+static uint64_t Random(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ULL;
+}
+
+/**
+* Losuje niezerowy wspólczynnik z przedzialu [-1000, 1000].
+* @return wspólczynnik
+*/
+static poly_coeff_t RandomCoeff(void)
+{
+    poly_coeff_t c = (poly_coeff_t)(Random() % 2000) - 1000;
+    return (c >= 0) ? c + 1 : c;
+}
+
+/**
+* Tworzy wielomian zmiennej x0 o stalych wspólczynnikach
+* i podanych wykladnikach.
+* @param[in] size: liczba jednomianów
+* @param[in] stride: odstep miedzy kolejnymi wykladnikami
+* @param[in] jitter: zakres losowego przesuniecia wykladnika, mniejszy niz stride
+* @return wielomian
+*/
+static Poly MakeLinear(size_t size, poly_exp_t stride, poly_exp_t jitter)
+{
+    Mono* monos = malloc(size * sizeof(Mono));
+    CHECK_PTR(monos);
+    for (size_t i = 0; i < size; i++)
+    {
+        Poly c = PolyFromCoeff(RandomCoeff());
+        poly_exp_t shift = (jitter > 0) ? (poly_exp_t)(Random() % jitter) : 0;
+        monos[i] = MonoFromPoly(&c, (poly_exp_t)i * stride + shift);
+    }
+    Poly p = PolyAddMonos(size, monos);
+    free(monos);
+    return p;
+}
+
+/**
+* Tworzy wielomian zagniezdzony: na kazdym z depth poziomów
+* jednomiany stopnia 0 i 1 kolejnej zmiennej o wspólczynnikach z nizszego
+* poziomu. Wielomiany tego ksztaltu róznia sie tylko stalymi, wiec operacje
+* na nich schodza do najglebszego poziomu.
+* @param[in] depth: glebokosc zagniezdzenia
+* @return wielomian
+*/
+static Poly MakeDeep(size_t depth)
+{
+    if (depth == 0)
+    {
+        return PolyFromCoeff(RandomCoeff());
+    }
+    Mono monos[2];
+    for (poly_exp_t i = 0; i < 2; i++)
+    {
+        Poly c = MakeDeep(depth - 1);
+        monos[i] = MonoFromPoly(&c, i);
+    }
+    return PolyAddMonos(2, monos);
+}
+
+/**
+* Tworzy szeroki wielomian dwóch zmiennych: side jednomianów zmiennej x0,
+* z których kazdy ma za wspólczynnik side jednomianów zmiennej x1.
+* @param[in] side: liczba jednomianów na kazdym poziomie
+* @return wielomian
+*/
+static Poly MakeWide(size_t side)
+{
+    Mono* monos = malloc(side * sizeof(Mono));
+    CHECK_PTR(monos);
+    for (size_t i = 0; i < side; i++)
+    {
+        Poly c = MakeLinear(side, 4, 4);
+        monos[i] = MonoFromPoly(&c, (poly_exp_t)i * 4 + (poly_exp_t)(Random() % 4));
+    }
+    Poly p = PolyAddMonos(side, monos);
+    free(monos);
+    return p;
+}
+
+/**
+* Ksztalt generowanego wielomianu.
+*/
+typedef enum
+{
+    SHAPE_SPARSE, ///< rzadki wielomian jednej zmiennej
+    SHAPE_DENSE, ///< gesty wielomian jednej zmiennej
+    SHAPE_DEEP, ///< gleboko zagniezdzony wielomian wielu zmiennych
+    SHAPE_WIDE, ///< szeroki wielomian dwóch zmiennych
+    SHAPE_COUNT ///< liczba ksztaltów
+}   Shape;
+
+/**
+Nazwy ksztaltów w wynikach.
+*/
+static const char* const shape_names[SHAPE_COUNT] = {
+    [SHAPE_SPARSE] = "sparse",
+    [SHAPE_DENSE] = "dense",
+    [SHAPE_DEEP] = "deep",
+    [SHAPE_WIDE] = "wide",
+};
+
+/**
+* Tworzy wielomian danego ksztaltu o okolo size wyrazach. Wynik zalezy
+* tylko od ziarna, ksztaltu, rozmiaru i numeru wariantu.
+* @param[in] shape: ksztalt
+* @param[in] size: przyblizona liczba wyrazów
+* @param[in] seed: ziarno
+* @param[in] variant: numer wariantu, pozwalajacy wygenerowac rózne argumenty
+* @return wielomian
+*/
+static Poly MakePoly(Shape shape, size_t size, uint64_t seed, uint64_t variant)
+{
+    random_state = (seed * 0x9E3779B97F4A7C15ULL) ^ (variant + 1) ^ ((uint64_t)shape << 32) ^ size;
+    if (random_state == 0)
+    {
+        random_state = 1;
+    }
+    size_t k = 1;
+    switch (shape)
+    {
+        case SHAPE_SPARSE:
+            return MakeLinear(size, 1000, 1000);
+        case SHAPE_DENSE:
+            return MakeLinear(size, 1, 0);
+        case SHAPE_DEEP:
+            while (((size_t)2 << k) <= size)
+            {
+                k++;
+            }
+            return MakeDeep(k);
+        case SHAPE_WIDE:
+            while ((k + 1) * (k + 1) <= size)
+            {
+                k++;
+            }
+            return MakeWide(k);
+        case SHAPE_COUNT:
+            break;
+    }
+    return PolyZero();
+}
+
+/**
+* Liczy wyrazy wielomianu, czyli jednomiany o stalych wspólczynnikach
+* na wszystkich poziomach zagniezdzenia.
+* @param[in] p: wielomian
+* @return liczba wyrazów
+*/
+static size_t CountTerms(const Poly* p)
+{
+    if (p->arr == NULL)
+    {
+        return 1;
+    }
+    size_t terms = 0;
+    for (size_t i = 0; i < p->size; i++)
+    {
+        terms += CountTerms(&p->arr[i].p);
+    }
+    return terms;
+}
+
+/**
+* Argumenty mierzonej operacji.
+*/
+typedef struct
+{
+    Poly p; ///< pierwszy argument
+    Poly q; ///< drugi argument, niezalezny od pierwszego
+    Poly p_copy; ///< kopia pierwszego argumentu w osobnej pamieci
+}   Args;
+
+/**
+* Mierzy PolyAdd.
+* @param[in] a: argumenty
+*/
+static void RunAdd(Args* a)
+{
+    Poly r = PolyAdd(&a->p, &a->q);
+    PolyDestroy(&r);
+}
+
+/**
+* Mierzy PolyMul.
+* @param[in] a: argumenty
+*/
+static void RunMul(Args* a)
+{
+    Poly r = PolyMul(&a->p, &a->q);
+    PolyDestroy(&r);
+}
+
+/**
+* Mierzy PolyAt.
+* @param[in] a: argumenty
+*/
+static void RunAt(Args* a)
+{
+    Poly r = PolyAt(&a->p, 3);
+    PolyDestroy(&r);
+}
+
+/**
+* Mierzy PolyClone.
+* @param[in] a: argumenty
+*/
+static void RunClone(Args* a)
+{
+    Poly r = PolyClone(&a->p);
+    PolyDestroy(&r);
+}
+
+/**
+* Mierzy PolyIsEq na równych wielomianach w osobnej pamieci,
+* co wymusza porównanie wszystkich wyrazów.
+* @param[in] a: argumenty
+*/
+static void RunIsEq(Args* a)
+{
+    if (!PolyIsEq(&a->p, &a->p_copy))
+    {
+        exit(1);
+    }
+}
+
+/**
+* Mierzy PolyDeg.
+* @param[in] a: argumenty
+*/
+static void RunDeg(Args* a)
+{
+    volatile poly_exp_t deg = PolyDeg(&a->p);
+    (void)deg;
+}
+
+/**
+* Mierzy PolyDegBy wzgledem zmiennej x1.
+* @param[in] a: argumenty
+*/
+static void RunDegBy(Args* a)
+{
+    volatile poly_exp_t deg = PolyDegBy(&a->p, 1);
+    (void)deg;
+}
+
+/**
+* Mierzy PolyAddMonos na jednomianach pierwszego argumentu w odwrotnej
+* kolejnosci. Pomiar obejmuje kopiowanie jednomianów, bo funkcja przejmuje
+* je na wlasnosc; dzieki wspóldzieleniu wspólczynników kopie sa tanie.
+* @param[in] a: argumenty
+*/
+static void RunAddMonos(Args* a)
+{
+    if (a->p.arr == NULL)
+    {
+        return;
+    }
+    size_t size = a->p.size;
+    Mono* monos = malloc(size * sizeof(Mono));
+    CHECK_PTR(monos);
+    for (size_t i = 0; i < size; i++)
+    {
+        monos[i] = MonoClone(&a->p.arr[size - 1 - i]);
+    }
+    Poly r = PolyAddMonos(size, monos);
+    free(monos);
+    PolyDestroy(&r);
+}
+
+/**
+* Opis mierzonej operacji.
+*/
+typedef struct
+{
+    const char* name; ///< nazwa w wynikach
+    void (*run)(Args*); ///< jedno wykonanie operacji
+    bool binary; ///< czy operacja ma dwa argumenty
+    size_t max_size; ///< najwiekszy mierzony rozmiar argumentów
+}   Operation;
+
+/**
+Mierzone operacje. Mnozenie ma kwadratowy koszt, wiec jest mierzone
+na mniejszych argumentach.
+*/
+static const Operation operations[] = {
+    {"PolyAdd", RunAdd, true, SIZE_MAX},
+    {"PolyMul", RunMul, true, 256},
+    {"PolyAt", RunAt, false, SIZE_MAX},
+    {"PolyClone", RunClone, false, SIZE_MAX},
+    {"PolyIsEq", RunIsEq, false, SIZE_MAX},
+    {"PolyDeg", RunDeg, false, SIZE_MAX},
+    {"PolyDegBy", RunDegBy, false, SIZE_MAX},
+    {"PolyAddMonos", RunAddMonos, false, SIZE_MAX},
+};
+
+/**
+Mierzone rozmiary argumentów, w przyblizonej liczbie wyrazów.
+*/
+static const size_t sizes[] = {16, 256, 4096};
+
+/**
+* Zwraca biezacy czas monotoniczny w nanosekundach.
+* @return czas
+*/
+static double NowNs(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+* Zwraca najwieksze dotychczasowe zuzycie pamieci przez proces.
+* @return szczytowy rozmiar zbioru rezydentnego w kilobajtach
+*/
+static long PeakRssKb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+* Wynik pomiaru jednego przypadku.
+*/
+typedef struct
+{
+    const char* op; ///< nazwa operacji
+    const char* shape; ///< nazwa ksztaltu
+    size_t size; ///< rozmiar argumentów
+    size_t terms; ///< laczna liczba wyrazów argumentów
+    size_t iters; ///< liczba wykonan
+    double ns_per_op; ///< sredni czas wykonania
+    double allocs_per_op; ///< srednia liczba przydzielen pamieci
+    long peak_rss_kb; ///< szczytowe zuzycie pamieci procesu do tej chwili
+}   Result;
+
+/**
+* Mierzy operacje, podwajajac liczbe wykonan, az pomiar potrwa
+* co najmniej min_time_ns.
+* @param[in] op: operacja
+* @param[in] a: argumenty
+* @param[in] min_time_ns: minimalny czas pomiaru
+* @param[out] r: wynik
+*/
+static void Measure(const Operation* op, Args* a, double min_time_ns, Result* r)
+{
+    op->run(a);
+    size_t iters = 1;
+    while (1)
+    {
+        size_t allocs = atomic_load(&allocations);
+        double start = NowNs();
+        for (size_t i = 0; i < iters; i++)
+        {
+            op->run(a);
+        }
+        double elapsed = NowNs() - start;
+        if (elapsed >= min_time_ns || iters >= ((size_t)1 << 40))
+        {
+            r->iters = iters;
+            r->ns_per_op = elapsed / iters;
+            r->allocs_per_op = (double)(atomic_load(&allocations) - allocs) / iters;
+            r->peak_rss_kb = PeakRssKb();
+            return;
+        }
+        iters *= 2;
+    }
+}
+
+/**
+* Wypisuje wynik w wybranym formacie.
+* @param[in] r: wynik
+* @param[in] json: czy wypisac obiekt JSON zamiast wiersza CSV
+* @param[in] first: czy to pierwszy wynik
+*/
+static void PrintResult(const Result* r, bool json, bool first)
+{
+    double terms_per_s = r->terms * 1e9 / r->ns_per_op;
+    if (json)
+    {
+        printf("%s\n  {\"op\": \"%s\", \"shape\": \"%s\", \"size\": %zu, \"terms\": %zu, "
+               "\"iters\": %zu, \"ns_per_op\": %.1f, \"terms_per_s\": %.0f, "
+               "\"allocs_per_op\": %.2f, \"peak_rss_kb\": %ld}",
+               first ? "" : ",", r->op, r->shape, r->size, r->terms,
+               r->iters, r->ns_per_op, terms_per_s, r->allocs_per_op, r->peak_rss_kb);
+    }
+    else
+    {
+        printf("%s,%s,%zu,%zu,%zu,%.1f,%.0f,%.2f,%ld\n",
+               r->op, r->shape, r->size, r->terms,
+               r->iters, r->ns_per_op, terms_per_s, r->allocs_per_op, r->peak_rss_kb);
+    }
+    fflush(stdout);
+}
+
+/**
+* Wypisuje sposób uzycia programu.
+* @param[in] name: nazwa programu
+*/
+static void Usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-f csv|json] [-s seed] [-t min_ms] [-j threads] [-o operation]\n",
+            name);
+}
+
+/**
+* Uruchamia pomiary wszystkich operacji na wszystkich ksztaltach
+* i rozmiarach argumentów.
+* @param[in] argc: liczba argumentów
+* @param[in] argv: argumenty
+* @return kod wyjscia programu
+*/
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    uint64_t seed = 1;
+    double min_time_ns = DEFAULT_MIN_TIME_MS * 1e6;
+    const char* only = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (strcmp(argv[i - 1], "-f") == 0 && (strcmp(value, "csv") == 0 || strcmp(value, "json") == 0))
+        {
+            json = (strcmp(value, "json") == 0);
+        }
+        else if (strcmp(argv[i - 1], "-s") == 0)
+        {
+            seed = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(argv[i - 1], "-t") == 0)
+        {
+            min_time_ns = strtod(value, NULL) * 1e6;
+        }
+        else if (strcmp(argv[i - 1], "-j") == 0)
+        {
+            PolySetThreads(strtoul(value, NULL, 10));
+        }
+        else if (strcmp(argv[i - 1], "-o") == 0)
+        {
+            only = value;
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (json)
+    {
+        printf("[");
+    }
+    else
+    {
+        printf("op,shape,size,terms,iters,ns_per_op,terms_per_s,allocs_per_op,peak_rss_kb\n");
+    }
+    bool first = true;
+    for (size_t o = 0; o < sizeof(operations) / sizeof(operations[0]); o++)
+    {
+        const Operation* op = &operations[o];
+        if (only != NULL && strcmp(only, op->name) != 0)
+        {
+            continue;
+        }
+        for (Shape shape = 0; shape < SHAPE_COUNT; shape++)
+        {
+            for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+            {
+                if (sizes[k] > op->max_size)
+                {
+                    continue;
+                }
+                Args a;
+                a.p = MakePoly(shape, sizes[k], seed, 0);
+                a.q = MakePoly(shape, sizes[k], seed, 1);
+                a.p_copy = MakePoly(shape, sizes[k], seed, 0);
+
+                Result r = {.op = op->name, .shape = shape_names[shape], .size = sizes[k]};
+                r.terms = CountTerms(&a.p) + (op->binary ? CountTerms(&a.q) : 0);
+                Measure(op, &a, min_time_ns, &r);
+                PrintResult(&r, json, first);
+                first = false;
+
+                PolyDestroy(&a.p);
+                PolyDestroy(&a.q);
+                PolyDestroy(&a.p_copy);
+            }
+        }
+    }
+    if (json)
+    {
+        printf("\n]\n");
+    }
+
+    PolySetThreads(0);
+    return 0;
+}
@@ -0,0 +1,308 @@
+/** @file
+  Generator powtarzalnych skryptów dla kalkulatora wielomianów.
+  Dla tego samego ziarna i tych samych opcji tworzy zawsze ten sam skrypt.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+Górne ograniczenie szacowanej liczby jednomianów wielomianu na stosie.
+Mnozenie, które by je przekroczylo, jest zastepowane dodawaniem,
+zeby czas wykonania skryptu rósl liniowo z jego dlugoscia.
+*/
+#define MAX_ESTIMATED_TERMS 4096
+
+/**
+Maksymalna liczba wielomianów na stosie w skrypcie mieszanym.
+*/
+#define MAX_STACK 32
+
+/**
+Liczba polecen PRINT na jeden wielomian w skrypcie wypisujacym.
+*/
+#define PRINTS_PER_POLY 100
+
+/**
+* Rodzaj generowanego skryptu.
+*/
+typedef enum
+{
+    KIND_MIXED, ///< wielomiany przeplatane poleceniami ADD, MUL, AT, PRINT, CLONE i POP
+    KIND_PARSE, ///< same wielomiany, kazdy od razu zdejmowany ze stosu
+    KIND_PRINT ///< nieliczne wielomiany, kazdy wypisywany wiele razy
+}   Kind;
+
+/**
+* Opcje generatora.
+*/
+typedef struct
+{
+    uint64_t seed; ///< ziarno
+    size_t lines; ///< liczba linijek skryptu
+    unsigned int depth; ///< maksymalna glebokosc zagniezdzenia wielomianów
+    unsigned int terms; ///< maksymalna liczba jednomianów na kazdym poziomie
+    Kind kind; ///< rodzaj skryptu
+}   Options;
+
+/**
+Stan generatora liczb pseudolosowych.
+*/
+static uint64_t random_state;
+
+/**
+* Losuje liczbe generatorem xorshift64*; wyniki zaleza tylko od ziarna.
+* @return liczba pseudolosowa
+*/
+static uint64_t Random(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 2685821657736338717ULL;
+}
+
+/**
+* Losuje liczbe z przedzialu [0, n).
+* @param[in] n: dlugosc przedzialu
+* @return liczba
+*/
+static unsigned int RandomBelow(unsigned int n)
+{
+    return Random() % n;
+}
+
+/**
+* Wypisuje losowy wielomian i zwraca liczbe jego jednomianów najwyzszego poziomu.
+* @param[in] f: plik
+* @param[in] depth: maksymalna glebokosc zagniezdzenia
+* @param[in] terms: maksymalna liczba jednomianów na kazdym poziomie
+* @return liczba jednomianów, 1 dla wspólczynnika
+*/
+static size_t WritePoly(FILE* f, unsigned int depth, unsigned int terms)
+{
+    if (depth == 0 || RandomBelow(4) == 0)
+    {
+        fprintf(f, "%d", (int)RandomBelow(2001) - 1000);
+        return 1;
+    }
+    size_t count = 1 + RandomBelow(terms);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            putc('+', f);
+        }
+        putc('(', f);
+        WritePoly(f, depth - 1, terms);
+        fprintf(f, ",%u)", RandomBelow(2 * terms + 1));
+    }
+    return count;
+}
+
+/**
+* Wypisuje linijke z losowym wielomianem.
+* @param[in] f: plik
+* @param[in] o: opcje
+* @return liczba jednomianów najwyzszego poziomu
+*/
+static size_t WritePolyLine(FILE* f, const Options* o)
+{
+    size_t count = WritePoly(f, o->depth, o->terms);
+    putc('\n', f);
+    return count;
+}
+
+/**
+* Wypisuje skrypt mieszany. Sledzi liczbe wielomianów na stosie i szacowana
+* liczbe ich jednomianów, zeby polecenia nie powodowaly bledów
+* i zeby wielomiany nie rosly bez ograniczen.
+* @param[in] f: plik
+* @param[in] o: opcje
+*/
+static void WriteMixed(FILE* f, const Options* o)
+{
+    size_t sizes[MAX_STACK];
+    size_t used = 0;
+    for (size_t line = 0; line < o->lines; line++)
+    {
+        unsigned int r = RandomBelow(100);
+        if (used < 2 || (r < 40 && used < MAX_STACK))
+        {
+            sizes[used++] = WritePolyLine(f, o);
+        }
+        else if (r < 55 || (r < 60 && sizes[used - 1] * sizes[used - 2] > MAX_ESTIMATED_TERMS))
+        {
+            fprintf(f, "ADD\n");
+            sizes[used - 2] += sizes[used - 1];
+            used--;
+        }
+        else if (r < 60)
+        {
+            fprintf(f, "MUL\n");
+            sizes[used - 2] *= sizes[used - 1];
+            used--;
+        }
+        else if (r < 70)
+        {
+            fprintf(f, "AT %d\n", (int)RandomBelow(7) - 3);
+        }
+        else if (r < 80)
+        {
+            fprintf(f, "PRINT\n");
+        }
+        else if (r < 85 && used < MAX_STACK)
+        {
+            fprintf(f, "CLONE\n");
+            sizes[used] = sizes[used - 1];
+            used++;
+        }
+        else
+        {
+            fprintf(f, "POP\n");
+            used--;
+        }
+        if (sizes[used - 1] > MAX_ESTIMATED_TERMS)
+        {
+            sizes[used - 1] = MAX_ESTIMATED_TERMS;
+        }
+    }
+}
+
+/**
+* Wypisuje skrypt parsujacy: kazdy wielomian jest od razu zdejmowany ze stosu.
+* @param[in] f: plik
+* @param[in] o: opcje
+*/
+static void WriteParse(FILE* f, const Options* o)
+{
+    for (size_t line = 0; line + 1 < o->lines; line += 2)
+    {
+        WritePolyLine(f, o);
+        fprintf(f, "POP\n");
+    }
+}
+
+/**
+* Wypisuje skrypt wypisujacy: kazdy wielomian jest wypisywany wiele razy.
+* @param[in] f: plik
+* @param[in] o: opcje
+*/
+static void WritePrint(FILE* f, const Options* o)
+{
+    for (size_t line = 0; line < o->lines; line++)
+    {
+        if (line % (PRINTS_PER_POLY + 2) == 0)
+        {
+            WritePolyLine(f, o);
+        }
+        else if (line % (PRINTS_PER_POLY + 2) == PRINTS_PER_POLY + 1)
+        {
+            fprintf(f, "POP\n");
+        }
+        else
+        {
+            fprintf(f, "PRINT\n");
+        }
+    }
+}
+
+/**
+* Wypisuje sposób uzycia programu.
+* @param[in] name: nazwa programu
+*/
+static void Usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [-k mixed|parse|print] [-s seed] [-n lines] [-d depth] [-t terms] [-o file]\n",
+            name);
+}
+
+/**
+* Generuje skrypt wedlug opcji z linii polecen.
+* @param[in] argc: liczba argumentów
+* @param[in] argv: argumenty
+* @return kod wyjscia programu
+*/
+int main(int argc, char* argv[])
+{
+    Options o = {.seed = 1, .lines = 10000, .depth = 2, .terms = 4, .kind = KIND_MIXED};
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (i + 1 >= argc)
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+        if (strcmp(option, "-k") == 0 && strcmp(value, "mixed") == 0)
+        {
+            o.kind = KIND_MIXED;
+        }
+        else if (strcmp(option, "-k") == 0 && strcmp(value, "parse") == 0)
+        {
+            o.kind = KIND_PARSE;
+        }
+        else if (strcmp(option, "-k") == 0 && strcmp(value, "print") == 0)
+        {
+            o.kind = KIND_PRINT;
+        }
+        else if (strcmp(option, "-s") == 0)
+        {
+            o.seed = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(option, "-n") == 0)
+        {
+            o.lines = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(option, "-d") == 0)
+        {
+            o.depth = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(option, "-t") == 0 && strtoul(value, NULL, 10) > 0)
+        {
+            o.terms = strtoul(value, NULL, 10);
+        }
+        else if (strcmp(option, "-o") == 0)
+        {
+            path = value;
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE* f = (path == NULL) ? stdout : fopen(path, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 1;
+    }
+    random_state = o.seed * 0x9E3779B97F4A7C15ULL + 1;
+    switch (o.kind)
+    {
+        case KIND_MIXED:
+            WriteMixed(f, &o);
+            break;
+        case KIND_PARSE:
+            WriteParse(f, &o);
+            break;
+        case KIND_PRINT:
+            WritePrint(f, &o);
+            break;
+    }
+    if (fclose(f) != 0)
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -12,7 +12,17 @@
 #include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "poly.h"
+#include "pool.h"
+#include "queue.h"
+#include "stats.h"
 
 /**
 * Sprawdza, czy alokacja sie powiodla.
@@ -28,32 +38,239 @@
 * Maksymalne i minimalne wartosci argumentów.
 */
 #define max_coeff LLONG_MAX ///< 9223372036854775807
-#define max_coeff_string "9223372036854775807\0" ///< "9223372036854775807"
 #define min_coeff LLONG_MIN ///< -9223372036854775808
-#define min_coeff_string "-9223372036854775808\0" ///< "-9223372036854775808"
 #define max_exp INT_MAX ///< 2147483647
-#define max_exp_string "2147483647\0" ///< "2147483647"
 #define min_exp 0 ///< 0
-#define min_exp_string "0\0" ///< 0
 #define max_exp_arg ULLONG_MAX ///< 18446744073709551615
-#define max_exp_arg_string "18446744073709551615\0" ///< "18446744073709551615"
 #define min_exp_arg 0 ///< 0
-#define min_exp_arg_string "0\0" ///< "0"
+
+/**
+Maksymalna dlugosc komunikatu przekazywanego do watku wyjscia.
+*/
+#define MAX_MESSAGE 64
+
+/**
+Pojemnosc kolejek laczacych etapy potoku.
+*/
+#define PIPELINE_QUEUE 1024
+
+/**
+* Rodzaj elementu kolejki wyjscia.
+*/
+typedef enum
+{
+    OUTPUT_TEXT, ///< gotowy komunikat
+    OUTPUT_POLY, ///< wielomian do wypisania komenda PRINT
+    OUTPUT_END ///< koniec wyjscia
+}   OutputKind;
+
+/**
+* Element kolejki wyjscia.
+*/
+typedef struct
+{
+    OutputKind kind; ///< rodzaj elementu
+    FILE* stream; ///< strumien, do którego trafia komunikat
+    Poly p; ///< wielomian do wypisania
+    unsigned int num_of_lines; ///< numer linijki komendy PRINT
+    char text[MAX_MESSAGE]; ///< tresc komunikatu
+}   OutputItem;
+
+/**
+Kolejka do watku wyjscia lub NULL, jesli kalkulator dziala bez potoku
+i wyniki sa wypisywane od razu.
+*/
+static Queue* output_queue = NULL;
+
+/**
+* Wypisuje wynik lub komunikat o bledzie. W trybie potoku przekazuje go
+* watkowi wyjscia, który wypisuje komunikaty w kolejnosci ich zgloszenia.
+* @param[in] stream: strumien, stdout albo stderr
+* @param[in] format: format jak dla printf
+*/
+void Report(FILE* stream, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    if (output_queue == NULL)
+    {
+        vfprintf(stream, format, args);
+    }
+    else
+    {
+        OutputItem item = {.kind = OUTPUT_TEXT, .stream = stream};
+        vsnprintf(item.text, MAX_MESSAGE, format, args);
+        QueuePush(output_queue, &item);
+    }
+    va_end(args);
+}
+
+/**
+Minimalna laczna liczba jednomianów argumentów, od której operacja
+na stosie jest zlecana puli watków zamiast wykonywana od razu.
+*/
+#define DEFERRED_MIN_TERMS 32
+
+/**
+* Operacja na wielomianach ze stosu, która mozna wykonac asynchronicznie.
+*/
+typedef enum
+{
+    STACK_ADD, ///< suma dwóch wielomianów
+    STACK_SUB, ///< róznica dwóch wielomianów
+    STACK_MUL, ///< iloczyn dwóch wielomianów
+    STACK_NEG, ///< negacja wielomianu
+    STACK_AT ///< wartosc wielomianu w punkcie
+}   StackOp;
+
+struct StackTask;
+
+/**
+* Pozycja na stosie: gotowy wielomian albo wynik zleconej operacji.
+*/
+typedef struct
+{
+    Poly p; ///< wielomian, jesli jest juz obliczony
+    struct StackTask* task; ///< operacja obliczajaca wielomian lub NULL
+}   StackEntry;
+
+/**
+* Operacja zlecona puli watków. Trafia do puli dopiero wtedy, gdy wszystkie
+* jej argumenty sa obliczone, wiec zadne zadanie nie czeka na inne zadanie,
+* które jeszcze sie nie zaczelo.
+*/
+typedef struct StackTask
+{
+    PoolGroup group; ///< grupa, zatrzymana do zakonczenia operacji
+    StackOp op; ///< operacja
+    StackEntry args[2]; ///< argumenty: wierzcholek i pozycja pod nim
+    poly_coeff_t x; ///< punkt dla operacji STACK_AT
+    Poly result; ///< wynik
+    atomic_size_t missing; ///< liczba nieobliczonych argumentów, plus 1 na czas zlecania
+    _Atomic(struct StackTask*) consumer; ///< operacja czekajaca na wynik, NULL lub STACK_TASK_DONE
+}   StackTask;
+
+/**
+Obiekt, którego adres oznacza, ze operacja zostala juz wykonana.
+*/
+static StackTask stack_task_done;
+
+/**
+Wartosc pola consumer operacji, która zostala juz wykonana.
+*/
+#define STACK_TASK_DONE (&stack_task_done)
+
+/**
+* Zwraca wielomian z pozycji na stosie, czekajac na zakonczenie
+* obliczajacej go operacji. Czekajac, wykonuje inne zadania puli.
+* @param[in,out] e: pozycja na stosie
+* @return wielomian
+*/
+Poly StackEntryResolve(StackEntry* e)
+{
+    if (e->task != NULL)
+    {
+        PoolWait(&e->task->group);
+        e->p = e->task->result;
+        free(e->task);
+        e->task = NULL;
+    }
+    return e->p;
+}
+
+/**
+* Wykonuje operacje na wielomianach, przejmujac je na wlasnosc.
+* @param[in] op: operacja
+* @param[in] p: wielomian z wierzcholka
+* @param[in] q: wielomian spod wierzcholka, dla operacji dwuargumentowych
+* @param[in] x: punkt dla operacji STACK_AT
+* @return wynik operacji
+*/
+Poly StackOpApply(StackOp op, Poly* p, Poly* q, poly_coeff_t x)
+{
+    Poly res;
+    switch (op)
+    {
+        case STACK_ADD:
+            return PolyAddOwned(p, q);
+        case STACK_SUB:
+            return PolySubOwned(p, q);
+        case STACK_MUL:
+            return PolyMulOwned(p, q);
+        case STACK_NEG:
+            return PolyNegOwned(p);
+        case STACK_AT:
+            res = PolyAt(p, x);
+            PolyDestroy(p);
+            return res;
+    }
+    return PolyZero();
+}
+
+/**
+* Liczba argumentów operacji.
+* @param[in] op: operacja
+* @return 1 lub 2
+*/
+size_t StackOpArity(StackOp op)
+{
+    return (op == STACK_NEG || op == STACK_AT) ? 1 : 2;
+}
+
+void StackTaskRun(void* arg);
+
+/**
+* Odnotowuje obliczenie jednego argumentu operacji.
+* Zleca operacje puli, gdy wszystkie argumenty sa obliczone.
+* @param[in] t: operacja
+*/
+void StackTaskInputReady(StackTask* t)
+{
+    if (atomic_fetch_sub(&t->missing, 1) == 1)
+    {
+        PoolSpawn(&t->group, StackTaskRun, t);
+    }
+}
+
 /**
-Rozmiar potrzebny do alokacji stringa, do którego parsuje liczbe.
+* Wykonuje zlecona operacje w watku puli i powiadamia operacje,
+* która czeka na jej wynik.
+* @param[in] arg: operacja
 */
-#define len_of_coeff 23
+void StackTaskRun(void* arg)
+{
+    StackTask* t = arg;
+    Poly p = StackEntryResolve(&t->args[0]);
+    Poly q = PolyZero();
+    if (StackOpArity(t->op) == 2)
+    {
+        q = StackEntryResolve(&t->args[1]);
+    }
+    t->result = StackOpApply(t->op, &p, &q, t->x);
+
+    StackTask* consumer = atomic_exchange(&t->consumer, STACK_TASK_DONE);
+    PoolGroupRelease(&t->group);
+    if (consumer != NULL)
+    {
+        StackTaskInputReady(consumer);
+    }
+}
 
 /**
 Typ przechowujacy stos wielomianów.
 */
 typedef struct
 {
-    Poly* arr; ///< tablica przechowywanych wielomianów
+    StackEntry* arr; ///< tablica przechowywanych wielomianów
     size_t used; ///< liczba przechowywanych wielomianów
     size_t size; ///< zaalokowany rozmiar tablicy
 }   Stack;
 
+/**
+Czy operacje na stosie moga byc zlecane puli watków.
+*/
+static bool deferred_ops = false;
+
 /**
 * Tworzy pusty stos.
 * @param[out] s: stos
@@ -62,7 +279,7 @@ void StackInit(Stack* s)
 {
     s->used = 0;
     s->size = 1;
-    s->arr = malloc(sizeof(Poly));
+    s->arr = malloc(sizeof(StackEntry));
     CHECK_PTR(s->arr);
 }
 
@@ -78,7 +295,7 @@ bool StackIsUnderflow(Stack* s, unsigned int num_of_lines, unsigned int a)
 {
 	if (s->used < a)
     {
-        fprintf(stderr, "ERROR %d STACK UNDERFLOW\n", num_of_lines);
+        Report(stderr, "ERROR %d STACK UNDERFLOW\n", num_of_lines);
         return true;
     }
     return false;
@@ -95,22 +312,44 @@ bool StackIsEmpty(Stack* s)
 }
 
 /**
-* Wklada wielomian na wierzcholek stosu.
+* Wklada pozycje na wierzcholek stosu.
 * @param[in] s: stos
-* @param[in] p: wielomian
+* @param[in] e: pozycja
 */
-void StackPush(Stack* s, Poly *p)
+void StackPushEntry(Stack* s, StackEntry e)
 {
     if (s->used == s->size)
     {
         s->size = 2 * s->size;
-        s->arr = realloc(s->arr, s->size*sizeof(Poly));
+        s->arr = realloc(s->arr, s->size*sizeof(StackEntry));
         CHECK_PTR(s->arr);
     }
-    s->arr[s->used] = *p;
+    s->arr[s->used] = e;
     s->used++;
 }
 
+/**
+* Wklada wielomian na wierzcholek stosu.
+* @param[in] s: stos
+* @param[in] p: wielomian
+*/
+void StackPush(Stack* s, Poly *p)
+{
+    StackPushEntry(s, (StackEntry) {.p = *p, .task = NULL});
+}
+
+/**
+* Zwraca wielomian z danej pozycji stosu, liczac od wierzcholka,
+* czekajac tylko na operacje, która go oblicza.
+* @param[in] s: stos
+* @param[in] depth: 0 dla wierzcholka, 1 dla pozycji pod nim itd.
+* @return wielomian
+*/
+Poly StackAt(Stack* s, size_t depth)
+{
+    return StackEntryResolve(&s->arr[s->used - 1 - depth]);
+}
+
 /**
 * Odczytuje wielomian z wierzchoku stosu
 * @param[in] s: stos
@@ -118,25 +357,102 @@ void StackPush(Stack* s, Poly *p)
 */
 Poly StackTop(Stack *s)
 {
-    return s->arr[s->used-1];
+    return StackAt(s, 0);
 }
 
 /**
-* Odczytuje wielomian z wierzchoku i usuwa go ze stosu.
+* Zdejmuje pozycje z wierzcholka stosu, nie czekajac na jej obliczenie.
 * @param[in] s: stos
-* @return wielomian
+* @return pozycja
 */
-Poly StackPop(Stack* s)
+StackEntry StackPopEntry(Stack* s)
 {
-    Poly p = s->arr[s->used - 1];
+    StackEntry e = s->arr[s->used - 1];
     s->used--;
     if (s->used < s->size/4 - 1 && s->size / 4 > 0)
     {
         s->size = s->size / 2;
-        s->arr = realloc(s->arr, s->size * sizeof(Poly));
+        s->arr = realloc(s->arr, s->size * sizeof(StackEntry));
         CHECK_PTR(s->arr);
     }
-    return p;
+    return e;
+}
+
+/**
+* Odczytuje wielomian z wierzchoku i usuwa go ze stosu.
+* @param[in] s: stos
+* @return wielomian
+*/
+Poly StackPop(Stack* s)
+{
+    StackEntry e = StackPopEntry(s);
+    return StackEntryResolve(&e);
+}
+
+/**
+* Zleca puli watków operacje na wielomianach z wierzchu stosu i wklada
+* na stos pozycje z jej przyszlym wynikiem. Operacja jest zlecana tylko
+* wtedy, gdy to mozliwe i oplacalne: gdy którys argument nie jest jeszcze
+* obliczony albo argumenty sa duze. Kolejnosc i tresc wypisywanych wyników
+* nie zmieniaja sie, bo komendy odczytujace wielomian czekaja na jego obliczenie.
+* @param[in] s: stos z wystarczajaca liczba elementów
+* @param[in] op: operacja
+* @param[in] x: punkt dla operacji STACK_AT
+* @return czy operacja zostala zlecona
+*/
+bool StackDefer(Stack* s, StackOp op, poly_coeff_t x)
+{
+    if (!deferred_ops)
+    {
+        return false;
+    }
+    size_t arity = StackOpArity(op);
+    bool pending = false;
+    size_t terms = 0;
+    for (size_t i = 0; i < arity; i++)
+    {
+        StackEntry* e = &s->arr[s->used - 1 - i];
+        pending = pending || e->task != NULL;
+        terms += (e->task == NULL && e->p.arr != NULL) ? e->p.size : 0;
+    }
+    if (!pending && terms < DEFERRED_MIN_TERMS)
+    {
+        return false;
+    }
+
+    StackTask* t = malloc(sizeof(StackTask));
+    CHECK_PTR(t);
+    t->op = op;
+    t->x = x;
+    PoolGroupInit(&t->group);
+    PoolGroupHold(&t->group);
+    atomic_init(&t->missing, arity + 1);
+    atomic_init(&t->consumer, NULL);
+    for (size_t i = 0; i < arity; i++)
+    {
+        t->args[i] = StackPopEntry(s);
+        StackTask* input = t->args[i].task;
+        StackTask* expected = NULL;
+        if (input == NULL || !atomic_compare_exchange_strong(&input->consumer, &expected, t))
+        {
+            atomic_fetch_sub(&t->missing, 1);
+        }
+    }
+    StackPushEntry(s, (StackEntry) {.task = t});
+    StackTaskInputReady(t);
+    return true;
+}
+
+/**
+* Czeka na obliczenie wszystkich wielomianów na stosie.
+* @param[in] s: stos
+*/
+void StackResolve(Stack* s)
+{
+    for (size_t i = 0; i < s->used; i++)
+    {
+        StackEntryResolve(&s->arr[i]);
+    }
 }
 
 /**
@@ -147,7 +463,8 @@ void StackDestroy(Stack* s)
 {
     for (size_t i = 0; i < s->used; i++)
     {
-        PolyDestroy(&(s->arr[i]));
+        Poly p = StackEntryResolve(&s->arr[i]);
+        PolyDestroy(&p);
     }
     free(s->arr);
 }
@@ -155,9 +472,11 @@ void StackDestroy(Stack* s)
 /**
 * Wklada na wierzcholek stosu wielomian zerowy.
 * @param[in] s: stos
+* @param[in] num_of_lines: nieuzywany, dla zgodnosci z pozostalymi komendami
 */
-void InsertZero(Stack *s)
+void InsertZero(Stack *s, unsigned int num_of_lines)
 {
+    (void)num_of_lines;
     Poly p = PolyZero();
     StackPush(s, &p);
 }
@@ -174,7 +493,7 @@ void IsCoeff(Stack *s, unsigned int num_of_lines)
     {
         Poly p = StackTop(s);
         bool is = PolyIsCoeff(&p);
-        printf("%d\n", is);
+        Report(stdout, "%d\n", is);
     }
 }
 
@@ -190,7 +509,7 @@ void IsZero(Stack *s, unsigned int num_of_lines)
     {
         Poly p = StackTop(s);
         bool is = PolyIsZero(&p);
-        printf("%d\n", is);
+        Report(stdout, "%d\n", is);
     }
 }
 
@@ -217,13 +536,11 @@ void Clone(Stack *s, unsigned int num_of_lines)
 */
 void Add(Stack *s, unsigned int num_of_lines)
 {
-    if (!StackIsUnderflow(s, num_of_lines, 2))
+    if (!StackIsUnderflow(s, num_of_lines, 2) && !StackDefer(s, STACK_ADD, 0))
     {
         Poly p = StackPop(s);
         Poly q = StackPop(s);
-        Poly r = PolyAdd(&p, &q);
-        PolyDestroy(&p);
-        PolyDestroy(&q);
+        Poly r = PolyAddOwned(&p, &q);
         StackPush(s, &r);
     }
 }
@@ -236,13 +553,11 @@ void Add(Stack *s, unsigned int num_of_lines)
 */
 void Mul(Stack *s, unsigned int num_of_lines)
 {
-    if (!StackIsUnderflow(s, num_of_lines, 2))
+    if (!StackIsUnderflow(s, num_of_lines, 2) && !StackDefer(s, STACK_MUL, 0))
     {
         Poly p = StackPop(s);
         Poly q = StackPop(s);
-        Poly r = PolyMul(&p, &q);
-        PolyDestroy(&p);
-        PolyDestroy(&q);
+        Poly r = PolyMulOwned(&p, &q);
         StackPush(s, &r);
     }
 }
@@ -254,11 +569,10 @@ void Mul(Stack *s, unsigned int num_of_lines)
 */
 void Neg(Stack *s, unsigned int num_of_lines)
 {
-    if (!StackIsUnderflow(s, num_of_lines, 1))
+    if (!StackIsUnderflow(s, num_of_lines, 1) && !StackDefer(s, STACK_NEG, 0))
     {
         Poly p = StackPop(s);
-        Poly r = PolyNeg(&p);
-        PolyDestroy(&p);
+        Poly r = PolyNegOwned(&p);
         StackPush(s, &r);
     }
 }
@@ -271,13 +585,11 @@ void Neg(Stack *s, unsigned int num_of_lines)
 */
 void Sub(Stack *s, unsigned int num_of_lines)
 {
-    if (!StackIsUnderflow(s, num_of_lines, 2))
+    if (!StackIsUnderflow(s, num_of_lines, 2) && !StackDefer(s, STACK_SUB, 0))
     {
         Poly p = StackPop(s);
         Poly q = StackPop(s);
-        Poly r = PolySub(&p, &q);
-        PolyDestroy(&p);
-        PolyDestroy(&q);
+        Poly r = PolySubOwned(&p, &q);
         StackPush(s, &r);
     }
 }
@@ -297,7 +609,27 @@ void IsEq(Stack *s, unsigned int num_of_lines)
         Poly q = StackTop(s);
         StackPush(s, &p);
         bool is = PolyIsEq(&p, &q);
-        printf("%d\n", is);
+        Report(stdout, "%d\n", is);
+    }
+}
+
+/**
+* Sprawdza probabilistycznie, czy dwa wielomiany na wierzchu stosu są równe.
+* Wypisuje na standardowe wyjście 0 lub 1 oraz ograniczenie
+* prawdopodobieństwa, że wynik 1 jest błędny.
+* @param[in] s: stos
+* @param[in] rounds: liczba losowanych punktów
+* @param[in] num_of_lines: numer linijki do wypisania ewentualnego bledu
+*/
+void IsEqProb(Stack *s, unsigned int rounds, unsigned int num_of_lines)
+{
+    if (!StackIsUnderflow(s, num_of_lines, 2))
+    {
+        Poly p = StackAt(s, 0);
+        Poly q = StackAt(s, 1);
+        bool is = PolyIsEqProbable(&p, &q, rounds);
+        double error = is ? PolyIsEqProbableError(&p, &q, rounds) : 0;
+        Report(stdout, "%d %g\n", is, error);
     }
 }
 
@@ -313,7 +645,7 @@ void Deg(Stack *s, unsigned int num_of_lines)
     {
         Poly p = StackTop(s);
         poly_exp_t res = PolyDeg(&p);
-        printf("%d\n", res);
+        Report(stdout, "%d\n", res);
     }
 }
 
@@ -331,7 +663,7 @@ void DegBy(Stack *s, long int var_idx, unsigned int num_of_lines)
     {
         Poly p = StackTop(s);
         poly_exp_t res = PolyDegBy(&p, var_idx);
-        printf("%d\n", res);
+        Report(stdout, "%d\n", res);
     }
 }
 
@@ -345,7 +677,7 @@ void DegBy(Stack *s, long int var_idx, unsigned int num_of_lines)
 void At(Stack *s, poly_coeff_t x, unsigned int num_of_lines)
 {
 
-    if (!StackIsUnderflow(s, num_of_lines, 1))
+    if (!StackIsUnderflow(s, num_of_lines, 1) && !StackDefer(s, STACK_AT, x))
     {
         Poly p = StackPop(s);
         Poly res = PolyAt(&p, x);
@@ -354,8 +686,6 @@ void At(Stack *s, poly_coeff_t x, unsigned int num_of_lines)
     }
 }
 
-char* PolyToString(Poly* p);
-
 /**
 * Wypisuje na standardowe wyjście wielomian z wierzchołka stosu.
 * @param[in] s: stos
@@ -366,9 +696,16 @@ void Print(Stack *s, unsigned int num_of_lines)
     if (!StackIsUnderflow(s, num_of_lines, 1))
     {
         Poly p = StackTop(s);
-        char* p_str = PolyToString(&p);
-        puts(p_str);
-        free(p_str);
+        if (output_queue == NULL)
+        {
+            PolyPrint(stdout, &p);
+            putchar('\n');
+        }
+        else
+        {
+            OutputItem item = {.kind = OUTPUT_POLY, .p = PolyClone(&p), .num_of_lines = num_of_lines};
+            QueuePush(output_queue, &item);
+        }
     }
 }
 
@@ -408,39 +745,50 @@ typedef struct
 }   BlockOfString;
 
 /**
-* Znajduje ostatni przecinek we fragmencie stringa.
+* Parsuje w miejscu fragment stringa bedacy liczba bez znaku, czyli niepustym
+* ciagiem samych cyfr, sprawdzajac przepelnienie na biezaco.
+* Zero musi byc zapisane jako "0", a wartosc rowna limitowi bez zer wiodacych.
 * @param[in] b: fragment stringa
+* @param[in] beg: pozycja pierwszej cyfry
+* @param[in] limit: maksymalna dopuszczalna wartosc
 * @param[out] correct: bool, miernik powodzenia calej operacji.
+* @return wartosc liczby (0 w razie bledu)
 */
-size_t StringFindLastComma(BlockOfString* b, bool* correct)
+unsigned long long int ParseDigits(BlockOfString* b, size_t beg,
+                                   unsigned long long int limit, bool* correct)
 {
-    for (size_t res = b->end-1; res >= b->beg; res--)
+    if (beg >= b->end)
+    {
+        *correct = false;
+        return 0;
+    }
+    unsigned long long int res = 0;
+    for (size_t i = beg; i < b->end; i++)
     {
-        if (b->str[res] == ',')
+        char c = b->str[i];
+        if (c < '0' || c > '9')
         {
-            return res;
+            *correct = false;
+            return 0;
         }
-        if (res == 0)
+        unsigned int digit = c - '0';
+        if (res > (limit - digit) / 10)
         {
-            break;
+            *correct = false;
+            return 0;
         }
+        res = res * 10 + digit;
     }
-    *correct = false;
-    return 0;
-}
-
-/**
-* Na podstawie fragmentu stringa, zwraca string zawierajacy tylko ten fragment.
-* @param[in] b: fragment stringa
-* @return wskaznik na otrzymany string
-*/
-char* ExtractBlock(BlockOfString* b)
-{
-    char* to_int = malloc((b->end - b->beg + 1) * sizeof(char));
-    CHECK_PTR(to_int);
-    memcpy(to_int, &(b->str[b->beg]), (b->end - b->beg));
-    to_int[b->end - b->beg] = '\0';
-    return to_int;
+    bool leading_zero = (b->str[beg] == '0' && b->end - beg > 1);
+    if (res == 0 && (beg != b->beg || leading_zero))
+    {
+        *correct = false;
+    }
+    if (res == limit && leading_zero)
+    {
+        *correct = false;
+    }
+    return res;
 }
 
 /**
@@ -451,31 +799,17 @@ char* ExtractBlock(BlockOfString* b)
 */
 poly_coeff_t StringToCoeff(BlockOfString* b, bool* correct)
 {
-    char* to_int = ExtractBlock(b);
-    if (to_int[0] == '+' || isspace(to_int[0]))
-    {
-        *correct = false;
-    }
-    char* endptr;
-    poly_coeff_t res = strtol(to_int, &endptr, 10);
-    if (*endptr != '\0')
-    {
-        *correct = false;
-    }
-    if (res == 0 && strcmp(to_int, "0\0") != 0)
+    if (b->beg < b->end && b->str[b->beg] == '-')
     {
-        *correct = false;
-    }
-    if (res >= max_coeff && strcmp(to_int, max_coeff_string) != 0)
-    {
-        *correct = false;
-    }
-    if (res <= min_coeff && strcmp(to_int, min_coeff_string) != 0)
-    {
-        *correct = false;
+        unsigned long long int abs_min = (unsigned long long int)max_coeff + 1;
+        unsigned long long int res = ParseDigits(b, b->beg + 1, abs_min, correct);
+        if (res == 0)
+        {
+            return 0;
+        }
+        return -(poly_coeff_t)(res - 1) - 1;
     }
-    free(to_int);
-    return res;
+    return ParseDigits(b, b->beg, max_coeff, correct);
 }
 
 /**
@@ -486,31 +820,7 @@ poly_coeff_t StringToCoeff(BlockOfString* b, bool* correct)
 */
 poly_exp_t StringToExp(BlockOfString* b, bool* correct)
 {
-    char* to_int = ExtractBlock(b);
-    if (to_int[0] == '+' || isspace(to_int[0]) || to_int[0] == '-')
-    {
-        *correct = false;
-    }
-    char* endptr;
-    long int res = strtoul(to_int, &endptr, 10);
-    if (*endptr != '\0')
-    {
-        *correct = false;
-    }
-    if (res == 0 && strcmp(to_int, "0\0") != 0)
-    {
-        *correct = false;
-    }
-    if (res >= max_exp && strcmp(to_int, max_exp_string))
-    {
-        *correct = false;
-    }
-    if (res <= min_exp && strcmp(to_int, min_exp_string))
-    {
-        *correct = false;
-    }
-    free(to_int);
-    return res;
+    return ParseDigits(b, b->beg, max_exp, correct);
 }
 
 /**
@@ -521,362 +831,182 @@ poly_exp_t StringToExp(BlockOfString* b, bool* correct)
 */
 unsigned long long int StringToExpArg(BlockOfString* b, bool* correct)
 {
-    char* to_int = ExtractBlock(b);
-    if (to_int[0] == '+' || isspace(to_int[0]) || to_int[0] == '-')
-    {
-        *correct = false;
-    }
-    char* endptr;
-    unsigned long long int res = strtoull(to_int, &endptr, 10);
+    return ParseDigits(b, b->beg, max_exp_arg, correct);
+}
 
-    if (*endptr != '\0')
-    {
-        *correct = false;
-    }
-    if (res == 0 && strcmp(to_int, "0\0") != 0)
-    {
-        *correct = false;
-    }
-    if (res >= max_exp_arg && strcmp(to_int, max_exp_arg_string))
+/**
+* Wyodrebnia z poczatku fragmentu stringa liczbe, czyli najdluzszy ciag
+* cyfr i minusów, i przesuwa poczatek fragmentu za nia.
+* @param[in] b: fragment stringa
+* @return fragment stringa z liczba
+*/
+BlockOfString TakeNumber(BlockOfString* b)
+{
+    BlockOfString number = *b;
+    while (b->beg < b->end && (isdigit(b->str[b->beg]) || b->str[b->beg] == '-'))
     {
-        *correct = false;
+        b->beg++;
     }
-    if (res <= min_exp_arg && strcmp(to_int, min_exp_arg_string))
+    number.end = b->beg;
+    return number;
+}
+
+/**
+* Sprawdza, czy fragment stringa zaczyna sie od danego znaku.
+* Jesli tak, przesuwa poczatek fragmentu za ten znak.
+* @param[in] b: fragment stringa
+* @param[in] c: znak
+* @return bool
+*/
+bool TakeChar(BlockOfString* b, char c)
+{
+    if (b->beg < b->end && b->str[b->beg] == c)
     {
-        *correct = false;
+        b->beg++;
+        return true;
     }
-    free(to_int);
-    return res;
+    return false;
 }
 
-Poly StringToPoly(BlockOfString* b, bool* correct);
+Poly ParsePoly(BlockOfString* b, bool* correct);
 
 /**
-* Sprawdza warunki konieczne do konwersji fragmentu stringa w jednomian.
+* Parsuje jednomian z poczatku fragmentu stringa
+* i przesuwa poczatek fragmentu za niego.
 * @param[in] b: fragment stringa
 * @param[out] correct: bool, miernik powodzenia calej operacji.
-* @return bool
+* @return jednomian
 */
-bool StringToMonoInitialCheck(BlockOfString* b, bool* correct)
+Mono ParseMono(BlockOfString* b, bool* correct)
 {
-    if (!(*correct))
-    {
-        return false;
-    }
-    else if (b->end - b->beg <= 4 || b->end > b->len)
+    if (!TakeChar(b, '('))
     {
         *correct = false;
-        return false;
+        return MonoZero();
     }
-    else if (b->str[b->beg] != '(' || b->str[b->end-1] != ')')
+    Poly p = ParsePoly(b, correct);
+    if (!(*correct) || !TakeChar(b, ','))
     {
         *correct = false;
-        return false;
-    }
-    return true;
-}
-
-/**
-* Dzieli fragment stringa bedacy jednomianem na wielomian i wspólczynnik.
-* @param[in] b: fragment stringa
-* @param[out] only_poly: fragment stringa z wielomianem
-* @param[out] only_exp: fragment stringa ze wspólczynnikiem
-* @param[in] last_comma: pozycja ostatniego przecinka we fragmencie
-*/
-void SplitMono(BlockOfString* b, BlockOfString* only_poly, BlockOfString* only_exp, size_t last_comma)
-{
-    only_exp->beg = last_comma + 1;
-    only_exp->end = b->end - 1;
-    only_poly->beg = b->beg + 1;
-    only_poly->end = last_comma;
-}
-
-/**
-* Konwertuje fragment stringa do jednomianu.
-* @param[in] b: fragment stringa
-* @param[out] correct: bool, miernik powodzenia calej operacji.
-* @return jednomian
-*/
-Mono StringToMono(BlockOfString* b, bool* correct)
-{
-    if (!StringToMonoInitialCheck(b, correct))
-    {
+        PolyDestroy(&p);
         return MonoZero();
     }
-    else
+    BlockOfString only_exp = TakeNumber(b);
+    poly_exp_t exp = StringToExp(&only_exp, correct);
+    if (!(*correct) || !TakeChar(b, ')'))
     {
-        size_t last_comma = StringFindLastComma(b, correct);
-        if (!(*correct))
-        {
-            return MonoZero();
-        }
-
-        BlockOfString only_exp = *b;
-        BlockOfString only_poly = *b;
-        SplitMono(b, &only_poly, &only_exp, last_comma);
-
-        poly_exp_t exp = StringToExp(&only_exp, correct);
-        Poly p = StringToPoly(&only_poly, correct);
-        return MonoFromPoly(&p, exp);
+        *correct = false;
+        PolyDestroy(&p);
+        return MonoZero();
     }
+    return (Mono) {.p = p, .exp = exp};
 }
 
 /**
-* Dzieli fragment stringa na jednomiany, zwraca ich tablice.
+* Parsuje wielomian z poczatku fragmentu stringa
+* i przesuwa poczatek fragmentu za niego.
+* Przechodzi po stringu jednokrotnie, od lewej do prawej,
+* od razu budujac jednomiany.
 * @param[in] b: fragment stringa
-* @param[in] plus_signs: tablica z pozycjami plusów rozdzielajacych jednomiany
-* @param[in] plus_signs_size: liczba plusów rozdzielajcych jednoaminy
 * @param[out] correct: bool, miernik powodzenia calej operacji.
-* @return tablica jednomianów
+* @return wielomian
 */
-Mono* SplitToMonos(BlockOfString* b, size_t* plus_signs, size_t plus_signs_size, bool* correct)
+Poly ParsePoly(BlockOfString* b, bool* correct)
 {
-    Mono* monos = malloc((plus_signs_size + 1) * sizeof(Mono));
-    CHECK_PTR(monos);
-
-    if (plus_signs_size == 0)
+    if (b->beg >= b->end)
     {
-        monos[0] = StringToMono(b, correct);
+        *correct = false;
+        return PolyZero();
     }
-    else
+    if (b->str[b->beg] != '(')
     {
-        size_t begin = b->beg;
-        for (size_t i = 0; i < plus_signs_size; i++)
+        BlockOfString only_coeff = TakeNumber(b);
+        if (only_coeff.end == only_coeff.beg)
         {
-            BlockOfString temp_mono = *b;
-            temp_mono.beg = begin;
-            temp_mono.end = plus_signs[i];
-            monos[i] = StringToMono(&temp_mono, correct);
-            begin = plus_signs[i] + 1;
-            if (begin >= b->len)
-            {
-                correct = false;
-                return monos;
-            }
+            *correct = false;
+            return PolyZero();
         }
-        BlockOfString temp_mono = *b;
-        temp_mono.beg = begin;
-        temp_mono.end = b->end;
-        monos[plus_signs_size] = StringToMono(&temp_mono, correct);
+        return PolyFromCoeff(StringToCoeff(&only_coeff, correct));
     }
-    return monos;
-
-}
 
-/**
-* Szuka we fragmencie stringa plusów rozdzielajacych jednomiany.
-* @param[in] b: fragment stringa
-* @param[out] size: liczba plusów
-*/
-void CountPluses(BlockOfString* b, int* size)
-{
-    int num_of_brackets = 0;
-    for (size_t i = b->beg; i < b->end; i++)
+    size_t size = 0;
+    size_t capacity = 1;
+    Mono* monos = malloc(capacity * sizeof(Mono));
+    CHECK_PTR(monos);
+    do
     {
-        if (b->str[i] == '(')
+        if (size == capacity)
         {
-            num_of_brackets++;
+            capacity = 2 * capacity;
+            monos = realloc(monos, capacity * sizeof(Mono));
+            CHECK_PTR(monos);
         }
-        if (b->str[i] == ')')
-        {
-            num_of_brackets--;
-        }
-        if (b->str[i] == '+' && num_of_brackets == 0)
-        {
-            (*size)++;
-        }
-    }
-}
-
-/**
-* Szuka we fragmencie stringa plusów rozdzielajacych jednomiany,
-* wklada je do tablicy.
-* @param[in] b: fragment stringa
-* @param[out] res: tablica pozycji tych plusów.
-*/
-void PlusesToArray(BlockOfString* b, size_t* res)
-{
-    int count = 0;
-    int num_of_brackets = 0;
+        monos[size++] = ParseMono(b, correct);
+    } while (*correct && TakeChar(b, '+'));
 
-    for (size_t i = b->beg; i < b->end; i++)
+    if (!(*correct))
     {
-        if (b->str[i] == '(')
-        {
-            num_of_brackets++;
-        }
-        if (b->str[i] == ')')
-        {
-            num_of_brackets--;
-        }
-        if (b->str[i] == '+' && num_of_brackets == 0)
+        for (size_t i = 0; i < size; i++)
         {
-            res[count] = i;
-            count++;
+            MonoDestroy(&monos[i]);
         }
+        free(monos);
+        return PolyZero();
     }
-}
-
-/**
-* Szuka we fragmencie stringa plusów rozdzielajacych jednomiany,
-* tworzy ich tablice.
-* @param[in] b: fragment stringa
-* @param[out] size: rozmiar tablicy
-* @return tablica z numerami pozycji plusów
-*/
-size_t* StringFindPluses(BlockOfString* b, int* size)
-{
-    CountPluses(b, size);
-    size_t* res = malloc((*size) * sizeof(size_t));
-    CHECK_PTR(res);
-    PlusesToArray(b, res);
+    Poly res = PolyAddMonos(size, monos);
+    free(monos);
     return res;
 }
 
-/**
-* Sprawdza warunki konieczne do konwersji fragmentu stringa w wielomian.
-* @param[in] b: fragment stringa
-* @param[out] correct: bool, miernik powodzenia calej operacji.
-* @return bool
-*/
-bool StringToPolyInitialCheck(BlockOfString* b, bool* correct)
-{
-    if (!(*correct))
-    {
-        return false;
-    }
-    if (b->end <= b->beg || b->end > b->len)
-    {
-        *correct = false;
-        return false;
-    }
-    return true;
-}
-
 /**
 * Konwertuje fragment stringa do wielomianu.
+* Caly fragment musi byc poprawnym wielomianem.
 * @param[in] b: fragment stringa
 * @param[out] correct: bool, miernik powodzenia calej operacji.
 * @return wielomian
 */
 Poly StringToPoly(BlockOfString* b, bool* correct)
 {
-    if (!StringToPolyInitialCheck(b, correct))
-    {
-        return PolyZero();
-    }
-    if (b->str[b->beg] != '(')
-    {
-        return PolyFromCoeff(StringToCoeff(b, correct));
-    }
-
-    int plus_signs_size = 0;
-    size_t* plus_signs = StringFindPluses(b, &plus_signs_size);
-    Mono* monos = SplitToMonos(b, plus_signs, plus_signs_size, correct);
-    free(plus_signs);
-
-    if (!(*correct))
-    {
-        free(monos);
-        return PolyZero();
-    }
-
-    Poly res = PolyAddMonos(plus_signs_size + 1, monos);
-    free(monos);
-    return res;
-}
-
-/**
-* Konwertuje jednomian do stringa.
-* @param[in] m: jednomian
-* @return tablica charów
-*/
-char* MonoToString(Mono* m)
-{
-    char* p_string = PolyToString(&(m->p));
-    char* str = malloc((strlen(p_string) + len_of_coeff) * sizeof(char));
-    CHECK_PTR(str);
-
-    str[0] = '\0';
-    strcat(str, "(\0");
-    strcat(str, p_string);
-    strcat(str, ",\0");
-
-    char* exp_str = malloc(len_of_coeff * sizeof(char));
-    CHECK_PTR(exp_str);
-    sprintf(exp_str, "%d", m->exp);
-    strcat(str, exp_str);
-    strcat(str, ")\0");
-    free(exp_str);
-    free(p_string);
-
-    return str;
-}
-
-/**
-* Konwertuje wielomian do stringa.
-* @param[in] p: wielomian
-* @return tablica charów
-*/
-char* PolyToString(Poly* p)
-{
-    char* str;
-    if (PolyIsCoeff(p))
+    BlockOfString rest = *b;
+    Poly p = ParsePoly(&rest, correct);
+    if (*correct && rest.beg != rest.end)
     {
-        str = malloc(len_of_coeff * sizeof(char));
-        CHECK_PTR(str);
-        sprintf(str, "%ld", p->coeff);
-        return str;
-    }
-    str = malloc(2 * sizeof(char));
-    CHECK_PTR(str);
-    str[0] = '\0';
-    size_t len_of_str = 0;
-
-    for (unsigned int i = 0; i < p->size; i++)
-    {
-        char* mono_str = MonoToString(&(p->arr[i]));
-        len_of_str += strlen(mono_str);
-        if (i != 0)
-        {
-            len_of_str++;
-            strcat(str, "+\0");
-        }
-        str = realloc(str, (len_of_str+2)*sizeof(char));
-        CHECK_PTR(str);
-        strcat(str, mono_str);
-        free(mono_str);
+        *correct = false;
     }
-    return str;
+    return p;
 }
 
 /**
 * Sprawdza, czy linijka jest komentarzem, jest pusta, lub zawiera znak null.
 * Wypisuje ewentualny komunikat o bledzie.
 * @param[in] line: linijka
-* @param[in] getline_value: wartosc zwrócona przez funkcje getline
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
 * @param[in] num_of_lines: numer linijki potrzebny do wypisania bledu
 * @return bool
 */
-bool LineIsEmptyOrNull(char* line, int getline_value, int num_of_lines)
+bool LineIsEmptyOrNull(char* line, size_t length, int num_of_lines)
 {
+    if (length == 0)
+    {
+        return true;
+    }
     if (line[0] == '#')
     {
         return true;
     }
-    else if(getline_value != (int)strlen(line))
+    else if (memchr(line, '\0', length) != NULL)
     {
         if (isalpha(line[0]))
         {
-            fprintf(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
+            Report(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
         }
         else
         {
-            fprintf(stderr, "ERROR %d WRONG POLY\n", num_of_lines);
+            Report(stderr, "ERROR %d WRONG POLY\n", num_of_lines);
         }
         return true;
     }
-    else if (strlen(line) == 0 || (strlen(line) == 1 && line[0] == '\n'))
+    else if (length == 1 && line[0] == '\n')
     {
         return true;
     }
@@ -884,46 +1014,75 @@ bool LineIsEmptyOrNull(char* line, int getline_value, int num_of_lines)
 }
 
 /**
-* Parsuje linijke do wielomianu. Nastepnie wrzuca go na stos,
-* lub wypisuje komunikat o bledzie.
-* @param[out] s: stos
+Statystyki parsowania linijek z wielomianami.
+*/
+static Stats parse_stats = {.name = "parse"};
+
+/**
+* Parsuje linijke do wielomianu.
 * @param[in] line: linijka
-* @param[in] num_of_lines: numer linijki potrzebny do wypisania bledu
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[out] p: wielomian, jesli linijka jest poprawna
+* @param[in] num_of_lines: numer linijki potrzebny do statystyk
+* @return czy linijka jest poprawnym wielomianem
 */
-void LineToPoly(Stack* s, char* line, unsigned int num_of_lines)
+bool LineParse(char* line, size_t length, Poly* p, unsigned int num_of_lines)
 {
+    uint64_t start = StatsEnabled() ? StatsNow() : 0;
     bool correct = true;
     BlockOfString b;
     b.str = line;
     b.beg = 0;
-    b.end = strlen(line) - 1;
-    b.len = b.end + 1;
-    Poly p = StringToPoly(&b, &correct);
+    b.end = length - 1;
+    b.len = length;
+    *p = StringToPoly(&b, &correct);
+
+    if (!correct)
+    {
+        PolyDestroy(p);
+    }
+    if (StatsEnabled())
+    {
+        StatsRecord(&parse_stats, start, num_of_lines);
+    }
+    return correct;
+}
 
-    if (correct)
+/**
+* Parsuje linijke do wielomianu. Nastepnie wrzuca go na stos,
+* lub wypisuje komunikat o bledzie.
+* @param[out] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[in] num_of_lines: numer linijki potrzebny do wypisania bledu
+*/
+void LineToPoly(Stack* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    Poly p;
+    if (LineParse(line, length, &p, num_of_lines))
     {
         StackPush(s, &p);
     }
     else
     {
-        PolyDestroy(&p);
-        fprintf(stderr, "ERROR %d WRONG POLY\n", num_of_lines);
+        Report(stderr, "ERROR %d WRONG POLY\n", num_of_lines);
     }
 }
 
 /**
 * Wyodrebnia fragment stringa po komendzie.
 * @param[in] line: linijka
+* @param[in] length: dlugosc linijki
 * @param[in] command_length: dlugosc komendy
 * @return fragment stringa
 */
-BlockOfString BlockAfterCommand(char* line, size_t command_length)
+BlockOfString BlockAfterCommand(char* line, size_t length, size_t command_length)
 {
     BlockOfString b;
     b.str = line;
-    b.len = strlen(b.str);
+    b.len = length;
     b.beg = command_length + 1;
-    b.end = strlen(b.str);
+    b.end = length;
     return b;
 }
 
@@ -932,13 +1091,14 @@ BlockOfString BlockAfterCommand(char* line, size_t command_length)
 * lub wypisuje komunikat o bledzie.
 * @param[in] s: stos
 * @param[in] line: linijka
+* @param[in] length: dlugosc linijki
 * @param[in] num_of_lines: numer linijki
 */
-void DegByCheckArgs(Stack* s, char* line, unsigned int num_of_lines)
+void DegByCheckArgs(Stack* s, char* line, size_t length, unsigned int num_of_lines)
 {
     size_t command_length = strlen("DEG_BY\0");
     bool correct = true;
-    BlockOfString b = BlockAfterCommand(line, command_length);
+    BlockOfString b = BlockAfterCommand(line, length, command_length);
 
     if (b.str[b.end - 1] == '\n')
     {
@@ -946,31 +1106,35 @@ void DegByCheckArgs(Stack* s, char* line, unsigned int num_of_lines)
     }
     if (b.end <= b.beg)
     {
-        fprintf(stderr, "ERROR %d DEG BY WRONG VARIABLE\n", num_of_lines);
+        Report(stderr, "ERROR %d DEG BY WRONG VARIABLE\n", num_of_lines);
         return;
     }
     if (line[command_length] != ' ')
     {
-        fprintf(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
+        Report(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
         return;
     }
 
     poly_exp_t var_idx = StringToExpArg(&b, &correct);
     if (!correct)
     {
-        fprintf(stderr, "ERROR %d DEG BY WRONG VARIABLE\n", num_of_lines);
+        Report(stderr, "ERROR %d DEG BY WRONG VARIABLE\n", num_of_lines);
         return;
     }
     else if (var_idx >= max_exp)
     {
+        if (StackIsUnderflow(s, num_of_lines, 1))
+        {
+            return;
+        }
         Poly p = StackTop(s);
         if (PolyIsZero(&p))
         {
-            printf("-1\n");
+            Report(stdout, "-1\n");
         }
         else
         {
-            printf("0\n");
+            Report(stdout, "0\n");
         }
     }
     else
@@ -979,22 +1143,61 @@ void DegByCheckArgs(Stack* s, char* line, unsigned int num_of_lines)
     }
 }
 
+/**
+* Sprawdza, czy komenda IS_EQ_PROB zawiera prawidlowy argument i wykonuje ja,
+* lub wypisuje komunikat o bledzie.
+* @param[in] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki
+* @param[in] num_of_lines: numer linijki
+*/
+void IsEqProbCheckArgs(Stack* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    size_t command_length = strlen("IS_EQ_PROB\0");
+    bool correct = true;
+    BlockOfString b = BlockAfterCommand(line, length, command_length);
+
+    if (b.str[b.end - 1] == '\n')
+    {
+        b.end--;
+    }
+    if (b.end <= b.beg)
+    {
+        Report(stderr, "ERROR %d IS EQ PROB WRONG ROUNDS\n", num_of_lines);
+        return;
+    }
+    if (line[command_length] != ' ')
+    {
+        Report(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
+        return;
+    }
+
+    unsigned long long int rounds = StringToExpArg(&b, &correct);
+    if (!correct || rounds == 0 || rounds > UINT_MAX)
+    {
+        Report(stderr, "ERROR %d IS EQ PROB WRONG ROUNDS\n", num_of_lines);
+        return;
+    }
+    IsEqProb(s, rounds, num_of_lines);
+}
+
 /**
 * Sprawdza, czy komenda AT zawiera prawidlowy argument i wykonuje ja,
 * lub wypisuje komunikat o bledzie.
 * @param[in] s: stos
 * @param[in] line: linijka
+* @param[in] length: dlugosc linijki
 * @param[in] num_of_lines: numer linijki
 */
-void AtCheckArgs(Stack* s, char* line, unsigned int num_of_lines)
+void AtCheckArgs(Stack* s, char* line, size_t length, unsigned int num_of_lines)
 {
     size_t command_length = strlen("AT\0");
     bool correct = true;
-    BlockOfString b = BlockAfterCommand(line, command_length);
+    BlockOfString b = BlockAfterCommand(line, length, command_length);
 
     if (b.end <= b.beg)
     {
-        fprintf(stderr, "ERROR %d AT WRONG VALUE\n", num_of_lines);
+        Report(stderr, "ERROR %d AT WRONG VALUE\n", num_of_lines);
         return;
     }
     if (b.str[b.end - 1] == '\n')
@@ -1003,14 +1206,14 @@ void AtCheckArgs(Stack* s, char* line, unsigned int num_of_lines)
     }
     if (line[command_length] != ' ')
     {
-        fprintf(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
+        Report(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
         return;
     }
 
     poly_coeff_t val = StringToCoeff(&b, &correct);
     if (!correct)
     {
-        fprintf(stderr, "ERROR %d AT WRONG VALUE\n", num_of_lines);
+        Report(stderr, "ERROR %d AT WRONG VALUE\n", num_of_lines);
         return;
     }
     else
@@ -1020,104 +1223,469 @@ void AtCheckArgs(Stack* s, char* line, unsigned int num_of_lines)
 }
 
 /**
-* Sprawdza, czy linijka jest komenda.
-* Jesli tak, to wykonuje ja lub wypisuje komunikat o bledzie.
-* @param[in] s: stos
+Poczatek pliku z zapisem stosu, pozwalajacy rozpoznac format pliku.
+*/
+#define STACK_FILE_MAGIC "POLYSTACK1\n"
+
+/**
+* Wyodrebnia z linijki nazwe pliku bedaca argumentem komendy.
+* Wypisuje komunikat o bledzie, jesli argumentu brakuje.
 * @param[in] line: linijka
+* @param[in] length: dlugosc linijki
+* @param[in] command_length: dlugosc komendy
+* @param[in] error: tresc komunikatu o blednym argumencie
 * @param[in] num_of_lines: numer linijki
+* @return zaalokowana nazwa pliku lub NULL w razie bledu
 */
-bool IsCommand(Stack* s, char* line, unsigned int num_of_lines)
+char* FileArgument(char* line, size_t length, size_t command_length,
+                   const char* error, unsigned int num_of_lines)
 {
-    if (strcmp(line, "ZERO\n\0") == 0 || strcmp(line, "ZERO\0") == 0)
+    BlockOfString b = BlockAfterCommand(line, length, command_length);
+
+    if (b.str[b.end - 1] == '\n')
     {
-        InsertZero(s);
-        return true;
+        b.end--;
     }
-    else if (strcmp(line, "IS_COEFF\n\0") == 0 || strcmp(line, "IS_COEFF\0") == 0)
+    if (b.end < b.beg)
     {
-        IsCoeff(s, num_of_lines);
-        return true;
+        Report(stderr, "ERROR %d %s\n", num_of_lines, error);
+        return NULL;
     }
-    else if (strcmp(line, "IS_ZERO\n\0") == 0 || strcmp(line, "IS_ZERO\0") == 0)
+    if (line[command_length] != ' ')
     {
-        IsZero(s, num_of_lines);
-        return true;
+        Report(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
+        return NULL;
     }
-    else if (strcmp(line, "CLONE\n\0") == 0 || strcmp(line, "CLONE\0") == 0)
+    if (b.end == b.beg)
     {
-        Clone(s, num_of_lines);
-        return true;
+        Report(stderr, "ERROR %d %s\n", num_of_lines, error);
+        return NULL;
     }
-    else if (strcmp(line, "ADD\n\0") == 0 || strcmp(line, "ADD\0") == 0)
+
+    char* path = malloc(b.end - b.beg + 1);
+    CHECK_PTR(path);
+    memcpy(path, &b.str[b.beg], b.end - b.beg);
+    path[b.end - b.beg] = '\0';
+    return path;
+}
+
+/**
+* Zapisuje wszystkie wielomiany ze stosu, od dolu, do pliku binarnego.
+* @param[in] s: stos
+* @param[in] path: nazwa pliku
+* @return czy zapis sie powiódl
+*/
+bool StackSave(Stack* s, const char* path)
+{
+    FILE* f = fopen(path, "wb");
+    if (f == NULL)
     {
-        Add(s, num_of_lines);
-        return true;
+        return false;
     }
-    else if (strcmp(line, "MUL\n\0") == 0 || strcmp(line, "MUL\0") == 0)
+    bool correct = fputs(STACK_FILE_MAGIC, f) != EOF;
+    StackResolve(s);
+    for (size_t i = 0; i < s->used && correct; i++)
     {
-        Mul(s, num_of_lines);
-        return true;
+        correct = PolySerialize(f, &(s->arr[i].p));
     }
-    else if (strcmp(line, "NEG\n\0") == 0 || strcmp(line, "NEG\0") == 0)
+    if (fclose(f) != 0)
     {
-        Neg(s, num_of_lines);
-        return true;
+        correct = false;
     }
-    else if (strcmp(line, "SUB\n\0") == 0 || strcmp(line, "SUB\0") == 0)
+    return correct;
+}
+
+/**
+* Zastepuje zawartosc stosu wielomianami zapisanymi w pliku przez StackSave.
+* Jesli plik jest niepoprawny, stos pozostaje bez zmian.
+* @param[in,out] s: stos
+* @param[in] path: nazwa pliku
+* @return czy odczyt sie powiódl
+*/
+bool StackLoad(Stack* s, const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
     {
-        Sub(s, num_of_lines);
-        return true;
+        return false;
     }
-    else if (strcmp(line, "IS_EQ\n\0") == 0 || strcmp(line, "IS_EQ\0") == 0)
+    char magic[sizeof(STACK_FILE_MAGIC) - 1];
+    bool correct = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+        && memcmp(magic, STACK_FILE_MAGIC, sizeof(magic)) == 0;
+
+    Stack loaded;
+    StackInit(&loaded);
+    int c;
+    while (correct && (c = getc(f)) != EOF)
     {
-        IsEq(s, num_of_lines);
-        return true;
+        ungetc(c, f);
+        Poly p;
+        correct = PolyDeserialize(f, &p);
+        if (correct)
+        {
+            StackPush(&loaded, &p);
+        }
     }
-    else if (strcmp(line, "DEG\n\0") == 0 || strcmp(line, "DEG\0") == 0)
+    if (ferror(f))
     {
-        Deg(s, num_of_lines);
-        return true;
+        correct = false;
     }
-    else if (strcmp(line, "PRINT\n\0") == 0 || strcmp(line, "PRINT\0") == 0)
+    fclose(f);
+
+    if (!correct)
     {
-        Print(s, num_of_lines);
-        return true;
+        StackDestroy(&loaded);
+        return false;
     }
-    else if (strcmp(line, "POP\n\0") == 0 || strcmp(line, "POP\0") == 0)
+    StackDestroy(s);
+    *s = loaded;
+    return true;
+}
+
+/**
+* Sprawdza, czy komenda SAVE zawiera nazwe pliku i zapisuje do niego stos,
+* lub wypisuje komunikat o bledzie.
+* @param[in] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki
+* @param[in] num_of_lines: numer linijki
+*/
+void SaveCheckArgs(Stack* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    char* path = FileArgument(line, length, strlen("SAVE\0"), "SAVE WRONG FILE", num_of_lines);
+    if (path == NULL)
     {
-        Pop(s, num_of_lines);
-        return true;
+        return;
     }
-    else if (memcmp(line, "DEG_BY\n\0", strlen("DEG_BY\0")) == 0)
+    if (!StackSave(s, path))
     {
-        DegByCheckArgs(s, line, num_of_lines);
-        return true;
+        Report(stderr, "ERROR %d SAVE WRONG FILE\n", num_of_lines);
+    }
+    free(path);
+}
+
+/**
+* Sprawdza, czy komenda LOAD zawiera nazwe pliku i odtwarza z niego stos,
+* lub wypisuje komunikat o bledzie.
+* @param[in] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki
+* @param[in] num_of_lines: numer linijki
+*/
+void LoadCheckArgs(Stack* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    char* path = FileArgument(line, length, strlen("LOAD\0"), "LOAD WRONG FILE", num_of_lines);
+    if (path == NULL)
+    {
+        return;
     }
-    else if (memcmp(line, "AT\n\0", strlen("AT\0")) == 0)
+    if (!StackLoad(s, path))
     {
-        AtCheckArgs(s, line, num_of_lines);
-        return true;
+        Report(stderr, "ERROR %d LOAD WRONG FILE\n", num_of_lines);
     }
-
-    return false;
+    free(path);
 }
 
 /**
-* Tworzy stos wielomianów. Wczytuje ze standardowego wejscia komendy i je wykonuje,
-* parsuje wielomiany i umieszcza je na stosie. Wypisuje komunikaty o ewentualnych
-* bledach.
+* Typ opisujacy komende kalkulatora.
+* Komenda bez argumentów musi stanowic cala linijke, a komenda z argumentem
+* jest rozpoznawana po poczatku linijki i sama sprawdza swój argument.
 */
-int main()
+typedef struct
 {
-    Stack s;
-    StackInit(&s);
-    char *line = NULL;
+    const char* name; ///< nazwa komendy
+    size_t length; ///< dlugosc nazwy
+    void (*run)(Stack*, unsigned int); ///< wykonanie komendy bez argumentów
+    void (*run_with_args)(Stack*, char*, size_t, unsigned int); ///< wykonanie komendy z argumentem
+    Stats* stats; ///< statystyki wywolan komendy
+}   Command;
+
+/**
+Opis komendy bez argumentów.
+*/
+#define COMMAND(command, run) {command, sizeof(command) - 1, run, NULL, &(Stats){.name = command}}
+
+/**
+Opis komendy z argumentem.
+*/
+#define COMMAND_WITH_ARGS(command, run) {command, sizeof(command) - 1, NULL, run, &(Stats){.name = command}}
+
+/**
+Koniec listy komend.
+*/
+#define COMMANDS_END {NULL, 0, NULL, NULL, NULL}
+
+void PrintStats(Stack* s, unsigned int num_of_lines);
+
+/**
+* Komendy zaczynajace sie na dana litere.
+* Aby dodac komende, wystarczy dopisac ja do listy jej pierwszej litery.
+*/
+static const Command commands_a[] = {
+    COMMAND("ADD", Add),
+    COMMAND_WITH_ARGS("AT", AtCheckArgs),
+    COMMANDS_END
+};
+static const Command commands_c[] = {  ///< komendy na litere C
+    COMMAND("CLONE", Clone),
+    COMMANDS_END
+};
+static const Command commands_d[] = {  ///< komendy na litere D
+    COMMAND("DEG", Deg),
+    COMMAND_WITH_ARGS("DEG_BY", DegByCheckArgs),
+    COMMANDS_END
+};
+static const Command commands_i[] = {  ///< komendy na litere I
+    COMMAND("IS_COEFF", IsCoeff),
+    COMMAND("IS_ZERO", IsZero),
+    COMMAND("IS_EQ", IsEq),
+    COMMAND_WITH_ARGS("IS_EQ_PROB", IsEqProbCheckArgs),
+    COMMANDS_END
+};
+static const Command commands_l[] = {  ///< komendy na litere L
+    COMMAND_WITH_ARGS("LOAD", LoadCheckArgs),
+    COMMANDS_END
+};
+static const Command commands_m[] = {  ///< komendy na litere M
+    COMMAND("MUL", Mul),
+    COMMANDS_END
+};
+static const Command commands_n[] = {  ///< komendy na litere N
+    COMMAND("NEG", Neg),
+    COMMANDS_END
+};
+static const Command commands_p[] = {  ///< komendy na litere P
+    COMMAND("PRINT", Print),
+    COMMAND("POP", Pop),
+    COMMANDS_END
+};
+static const Command commands_s[] = {  ///< komendy na litere S
+    COMMAND("SUB", Sub),
+    COMMAND_WITH_ARGS("SAVE", SaveCheckArgs),
+    COMMAND("STATS", PrintStats),
+    COMMANDS_END
+};
+static const Command commands_z[] = {  ///< komendy na litere Z
+    COMMAND("ZERO", InsertZero),
+    COMMANDS_END
+};
+
+/**
+* Listy komend indeksowane pierwsza litera nazwy.
+*/
+static const Command* const commands_by_letter['Z' - 'A' + 1] = {
+    ['A' - 'A'] = commands_a,
+    ['C' - 'A'] = commands_c,
+    ['D' - 'A'] = commands_d,
+    ['I' - 'A'] = commands_i,
+    ['L' - 'A'] = commands_l,
+    ['M' - 'A'] = commands_m,
+    ['N' - 'A'] = commands_n,
+    ['P' - 'A'] = commands_p,
+    ['S' - 'A'] = commands_s,
+    ['Z' - 'A'] = commands_z,
+};
+
+/**
+* Sprawdza, czy linijka jest komenda.
+* Jesli tak, to wykonuje ja lub wypisuje komunikat o bledzie.
+* Porównuje linijke tylko z komendami zaczynajacymi sie na te sama litere.
+* @param[in] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[in] num_of_lines: numer linijki
+*/
+bool IsCommand(Stack* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    if (line[0] < 'A' || line[0] > 'Z' || commands_by_letter[line[0] - 'A'] == NULL)
+    {
+        return false;
+    }
+    for (const Command* c = commands_by_letter[line[0] - 'A']; c->name != NULL; c++)
+    {
+        if (length < c->length || memcmp(line, c->name, c->length) != 0)
+        {
+            continue;
+        }
+        uint64_t start = StatsEnabled() ? StatsNow() : 0;
+        if (c->run_with_args != NULL)
+        {
+            c->run_with_args(s, line, length, num_of_lines);
+        }
+        else if (length == c->length || (length == c->length + 1 && line[c->length] == '\n'))
+        {
+            c->run(s, num_of_lines);
+        }
+        else
+        {
+            continue;
+        }
+        if (StatsEnabled())
+        {
+            StatsRecord(c->stats, start, num_of_lines);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+/**
+Statystyki wypisywania wielomianów przez watek wyjscia w trybie potoku.
+*/
+static Stats output_stats = {.name = "PRINT output"};
+
+/**
+* Zapisuje czas w czytelnej jednostce.
+* @param[out] buffer: bufor na tekst
+* @param[in] size: rozmiar bufora
+* @param[in] ns: czas w nanosekundach
+*/
+void DurationToString(char* buffer, size_t size, double ns)
+{
+    if (ns < 1e3)
+    {
+        snprintf(buffer, size, "%.4gns", ns);
+    }
+    else if (ns < 1e6)
+    {
+        snprintf(buffer, size, "%.4gus", ns / 1e3);
+    }
+    else if (ns < 1e9)
+    {
+        snprintf(buffer, size, "%.4gms", ns / 1e6);
+    }
+    else
+    {
+        snprintf(buffer, size, "%.4gs", ns / 1e9);
+    }
+}
+
+/**
+* Wypisuje statystyki jednego rodzaju polecen, jesli byly wywolywane:
+* liczbe wywolan, laczny i sredni czas, kwantyle, najdluzszy czas
+* oraz niepuste przedzialy histogramu w skali logarytmicznej.
+* @param[in] stream: strumien
+* @param[in] st: statystyki
+*/
+void ReportCommandStats(FILE* stream, Stats* st)
+{
+    size_t count = atomic_load(&st->count);
+    if (count == 0)
+    {
+        return;
+    }
+    char total[16], mean[16], p50[16], p99[16], max[16];
+    uint64_t total_ns = atomic_load(&st->total_ns);
+    DurationToString(total, sizeof(total), total_ns);
+    DurationToString(mean, sizeof(mean), (double)total_ns / count);
+    DurationToString(p50, sizeof(p50), StatsQuantileBound(st, 0.5));
+    DurationToString(p99, sizeof(p99), StatsQuantileBound(st, 0.99));
+    DurationToString(max, sizeof(max), atomic_load(&st->max_ns));
+    Report(stream, "%s: %zu calls, total %s, mean %s", st->name, count, total, mean);
+    Report(stream, ", p50 <%s, p99 <%s, max %s\n", p50, p99, max);
+
+    Report(stream, "  %s histogram:", st->name);
+    for (size_t k = 0; k < STATS_BUCKETS; k++)
+    {
+        size_t in_bucket = atomic_load(&st->buckets[k]);
+        if (in_bucket > 0)
+        {
+            char bound[16];
+            DurationToString(bound, sizeof(bound), StatsBucketBound(k));
+            Report(stream, " <%s %zu", bound, in_bucket);
+        }
+    }
+    Report(stream, "\n");
+}
+
+/**
+* Wypisuje statystyki wszystkich komend, parsowania i wypisywania.
+* @param[in] stream: strumien
+*/
+void ReportStats(FILE* stream)
+{
+    for (size_t letter = 0; letter <= 'Z' - 'A'; letter++)
+    {
+        for (const Command* c = commands_by_letter[letter]; c != NULL && c->name != NULL; c++)
+        {
+            ReportCommandStats(stream, c->stats);
+        }
+    }
+    ReportCommandStats(stream, &parse_stats);
+    ReportCommandStats(stream, &output_stats);
+}
+
+/**
+* Wypisuje dotychczasowe statystyki wywolan lub komunikat o bledzie,
+* jesli statystyki nie sa zbierane.
+* @param[in] s: stos
+* @param[in] num_of_lines: numer linijki potrzebny do wypisania bledu
+*/
+void PrintStats(Stack* s, unsigned int num_of_lines)
+{
+    (void)s;
+    if (!StatsEnabled())
+    {
+        Report(stderr, "ERROR %d STATS DISABLED\n", num_of_lines);
+        return;
+    }
+    ReportStats(stdout);
+}
+
+/**
+* Wykonuje jedna linijke wejscia: pomija komentarze i puste linijki,
+* wykonuje komende lub parsuje wielomian i wrzuca go na stos.
+* Wypisuje komunikaty o ewentualnych bledach.
+* Linijka nie musi byc zakonczona znakiem null.
+* @param[in] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[in] num_of_lines: numer linijki
+*/
+void ExecuteLine(Stack* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    if (LineIsEmptyOrNull(line, length, num_of_lines))
+    {
+        return;
+    }
+
+    if (!IsCommand(s, line, length, num_of_lines))
+    {
+        if (isalpha(line[0]))
+        {
+            Report(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
+        }
+        else
+        {
+            LineToPoly(s, line, length, num_of_lines);
+        }
+    }
+}
+
+/**
+* Funkcja obslugujaca kolejna linijke wejscia.
+* @param[in] ctx: dane obslugujacego
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[in] num_of_lines: numer linijki
+*/
+typedef void (*LineHandler)(void* ctx, char* line, size_t length, unsigned int num_of_lines);
+
+/**
+* Wczytuje linijki ze standardowego wejscia i przekazuje je obslugujacemu.
+* @param[in] handle: funkcja obslugujaca linijke
+* @param[in] ctx: dane obslugujacego
+*/
+void ReadStdin(LineHandler handle, void* ctx)
+{
+    char *line = NULL;
     size_t size;
     unsigned int num_of_lines = 0;
 
     while (1)
     {
-        int getline_value = getline(&line, &size, stdin);
+        ssize_t getline_value = getline(&line, &size, stdin);
         CHECK_PTR(line);
         if (errno == ENOMEM)
         {
@@ -1129,25 +1697,380 @@ int main()
         }
 
         num_of_lines++;
-        if (LineIsEmptyOrNull(line, getline_value, num_of_lines))
-        {
-            continue;
-        }
+        handle(ctx, line, getline_value, num_of_lines);
+    }
+
+    free(line);
+}
+
+/**
+* Odwzorowuje plik w pamieci i przekazuje obslugujacemu jego kolejne linijki
+* bez kopiowania ich do osobnego bufora. Numery linijek sa takie same,
+* jak przy czytaniu tego pliku ze standardowego wejscia.
+* @param[in] path: sciezka do pliku
+* @param[in] handle: funkcja obslugujaca linijke
+* @param[in] ctx: dane obslugujacego
+* @return czy udalo sie otworzyc i odwzorowac plik
+*/
+bool ReadFile(const char* path, LineHandler handle, void* ctx)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    if (size == 0)
+    {
+        close(fd);
+        return true;
+    }
+    char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+    unsigned int num_of_lines = 0;
+    size_t beg = 0;
+    while (beg < size)
+    {
+        char* newline = memchr(data + beg, '\n', size - beg);
+        size_t end = (newline == NULL) ? size : (size_t)(newline - data) + 1;
+        num_of_lines++;
+        handle(ctx, data + beg, end - beg, num_of_lines);
+        beg = end;
+    }
+
+    munmap(data, size);
+    return true;
+}
+
+/**
+* Wykonuje linijke na stosie; obsluga linijek bez potoku.
+* @param[in] s: stos
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[in] num_of_lines: numer linijki
+*/
+void RunLine(void* s, char* line, size_t length, unsigned int num_of_lines)
+{
+    ExecuteLine(s, line, length, num_of_lines);
+}
+
+/**
+* Rodzaj elementu kolejki wejscia.
+*/
+typedef enum
+{
+    INPUT_POLY, ///< sparsowany wielomian
+    INPUT_WRONG_POLY, ///< niepoprawny wielomian
+    INPUT_PARSE, ///< wielomian parsowany przez pule watków
+    INPUT_LINE, ///< linijka do wykonania, np. komenda
+    INPUT_END ///< koniec wejscia
+}   InputKind;
+
+/**
+Minimalna dlugosc linijki z wielomianem, od której watek czytajacy
+zleca jej parsowanie puli watków zamiast parsowac ja sam.
+*/
+#define PARALLEL_PARSE_BYTES 256
+
+/**
+* Parsowanie linijki z wielomianem zlecone puli watków.
+*/
+typedef struct
+{
+    PoolGroup group; ///< grupa, na której zakonczenie czeka wykonawca
+    char* line; ///< zaalokowana kopia linijki
+    size_t length; ///< dlugosc linijki
+    Poly p; ///< sparsowany wielomian
+    bool correct; ///< czy linijka jest poprawnym wielomianem
+    unsigned int num_of_lines; ///< numer linijki
+}   ParseTask;
+
+/**
+* Parsuje linijke w watku puli.
+* @param[in] arg: zlecone parsowanie
+*/
+void ParseTaskRun(void* arg)
+{
+    ParseTask* t = arg;
+    t->correct = LineParse(t->line, t->length, &t->p, t->num_of_lines);
+    free(t->line);
+}
+
+/**
+* Element kolejki wejscia.
+*/
+typedef struct
+{
+    InputKind kind; ///< rodzaj elementu
+    unsigned int num_of_lines; ///< numer linijki
+    Poly p; ///< sparsowany wielomian
+    ParseTask* parse; ///< zlecone parsowanie wielomianu
+    char* line; ///< zaalokowana kopia linijki
+    size_t length; ///< dlugosc linijki
+}   InputItem;
+
+/**
+* Dane watku czytajacego wejscie.
+*/
+typedef struct
+{
+    Queue* input; ///< kolejka do wykonawcy
+    const char* path; ///< sciezka do pliku lub NULL dla standardowego wejscia
+    bool read; ///< czy udalo sie odczytac plik
+}   Reader;
+
+/**
+* Klasyfikuje linijke w watku czytajacym: pomija komentarze i puste linijki,
+* parsuje wielomiany, a pozostale linijki kopiuje do wykonania przez wykonawce.
+* Gdy dziala pula watków, dlugie linijki z wielomianami sa parsowane przez
+* pule, a wykonawca czeka na wynik dopiero wtedy, gdy dojdzie do tej linijki.
+* @param[in] ctx: dane watku czytajacego
+* @param[in] line: linijka
+* @param[in] length: dlugosc linijki razem z ewentualnym znakiem nowej linii
+* @param[in] num_of_lines: numer linijki
+*/
+void QueueLine(void* ctx, char* line, size_t length, unsigned int num_of_lines)
+{
+    Reader* r = ctx;
+    if (length == 0 || line[0] == '#')
+    {
+        return;
+    }
+    InputItem item = {.num_of_lines = num_of_lines};
+    if (memchr(line, '\0', length) != NULL || isalpha(line[0]))
+    {
+        item.kind = INPUT_LINE;
+        item.line = malloc(length);
+        CHECK_PTR(item.line);
+        memcpy(item.line, line, length);
+        item.length = length;
+    }
+    else if (length == 1 && line[0] == '\n')
+    {
+        return;
+    }
+    else if (length >= PARALLEL_PARSE_BYTES && PoolThreads() > 0)
+    {
+        item.kind = INPUT_PARSE;
+        item.parse = malloc(sizeof(ParseTask));
+        CHECK_PTR(item.parse);
+        item.parse->line = malloc(length);
+        CHECK_PTR(item.parse->line);
+        memcpy(item.parse->line, line, length);
+        item.parse->length = length;
+        item.parse->num_of_lines = num_of_lines;
+        PoolGroupInit(&item.parse->group);
+        PoolSpawn(&item.parse->group, ParseTaskRun, item.parse);
+    }
+    else
+    {
+        item.kind = LineParse(line, length, &item.p, num_of_lines) ? INPUT_POLY : INPUT_WRONG_POLY;
+    }
+    QueuePush(r->input, &item);
+}
+
+/**
+* Watek czytajacy i parsujacy wejscie.
+* @param[in] arg: dane watku czytajacego
+* @return NULL
+*/
+void* ReaderMain(void* arg)
+{
+    Reader* r = arg;
+    if (r->path != NULL)
+    {
+        r->read = ReadFile(r->path, QueueLine, r);
+    }
+    else
+    {
+        ReadStdin(QueueLine, r);
+    }
+    InputItem end = {.kind = INPUT_END};
+    QueuePush(r->input, &end);
+    return NULL;
+}
 
-        if (!IsCommand(&s, line, num_of_lines))
+/**
+* Watek wypisujacy wyniki i komunikaty o bledach w kolejnosci ich zgloszenia.
+* @param[in] arg: kolejka wyjscia
+* @return NULL
+*/
+void* OutputMain(void* arg)
+{
+    Queue* q = arg;
+    while (1)
+    {
+        OutputItem item;
+        QueuePop(q, &item);
+        switch (item.kind)
         {
-            if (isalpha(line[0]))
-            {
-                fprintf(stderr, "ERROR %d WRONG COMMAND\n", num_of_lines);
-            }
-            else
+            case OUTPUT_TEXT:
+                fputs(item.text, item.stream);
+                break;
+            case OUTPUT_POLY:
             {
-                LineToPoly(&s, line, num_of_lines);
+                uint64_t start = StatsEnabled() ? StatsNow() : 0;
+                PolyPrint(stdout, &item.p);
+                putchar('\n');
+                PolyDestroy(&item.p);
+                if (StatsEnabled())
+                {
+                    StatsRecord(&output_stats, start, item.num_of_lines);
+                }
+                break;
             }
+            case OUTPUT_END:
+                return NULL;
         }
     }
+}
+
+/**
+* Wykonuje wejscie w trzyetapowym potoku: watek czytajacy parsuje linijki,
+* biezacy watek wykonuje je na stosie, a watek wyjscia wypisuje wyniki.
+* Wyniki i komunikaty o bledach sa takie same i w tej samej kolejnosci,
+* jak przy wykonaniu bez potoku.
+* @param[in] s: stos
+* @param[in] path: sciezka do pliku lub NULL dla standardowego wejscia
+* @return czy udalo sie odczytac plik
+*/
+bool ExecutePipeline(Stack* s, const char* path)
+{
+    Reader r = {.input = QueueCreate(sizeof(InputItem), PIPELINE_QUEUE), .path = path, .read = true};
+    Queue* output = QueueCreate(sizeof(OutputItem), PIPELINE_QUEUE);
+    pthread_t reader, writer;
+    if (pthread_create(&reader, NULL, ReaderMain, &r) != 0
+        || pthread_create(&writer, NULL, OutputMain, output) != 0)
+    {
+        exit(1);
+    }
+    output_queue = output;
+
+    bool end = false;
+    while (!end)
+    {
+        InputItem item;
+        QueuePop(r.input, &item);
+        switch (item.kind)
+        {
+            case INPUT_POLY:
+                StackPush(s, &item.p);
+                break;
+            case INPUT_WRONG_POLY:
+                Report(stderr, "ERROR %d WRONG POLY\n", item.num_of_lines);
+                break;
+            case INPUT_PARSE:
+                PoolWait(&item.parse->group);
+                if (item.parse->correct)
+                {
+                    StackPush(s, &item.parse->p);
+                }
+                else
+                {
+                    Report(stderr, "ERROR %d WRONG POLY\n", item.num_of_lines);
+                }
+                free(item.parse);
+                break;
+            case INPUT_LINE:
+                ExecuteLine(s, item.line, item.length, item.num_of_lines);
+                free(item.line);
+                break;
+            case INPUT_END:
+                end = true;
+                break;
+        }
+    }
+
+    OutputItem item = {.kind = OUTPUT_END};
+    QueuePush(output, &item);
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+    output_queue = NULL;
+    QueueDestroy(r.input);
+    QueueDestroy(output);
+    return r.read;
+}
+
+/**
+* Tworzy stos wielomianów. Wczytuje komendy ze standardowego wejscia,
+* a jesli podano argument, to z pliku o tej nazwie, i je wykonuje.
+* Parsuje wielomiany i umieszcza je na stosie. Wypisuje komunikaty
+* o ewentualnych bledach.
+* Zmienna srodowiskowa POLY_THREADS wlacza obliczenia równolegle
+* na podanej liczbie watków, takze niezaleznych operacji na stosie,
+* a niezerowa wartosc zmiennej POLY_PIPELINE wykonanie w potoku.
+* Niezerowa wartosc zmiennej POLY_STATS wlacza zbieranie statystyk
+* wywolan i wypisanie ich na standardowe wyjscie bledów na koniec,
+* a zmienna POLY_TRACE wskazuje plik, do którego zostanie zapisany
+* slad wykonania w formacie Chrome trace event.
+* @param[in] argc: liczba argumentów
+* @param[in] argv: argumenty; opcjonalnie sciezka do pliku z komendami
+* @return kod wyjscia programu
+*/
+int main(int argc, char* argv[])
+{
+    const char* threads = getenv("POLY_THREADS");
+    if (threads != NULL)
+    {
+        PolySetThreads(strtoul(threads, NULL, 10));
+    }
+    deferred_ops = PoolThreads() > 0;
+    const char* pipeline = getenv("POLY_PIPELINE");
+    bool in_pipeline = (pipeline != NULL && strtoul(pipeline, NULL, 10) != 0);
+    const char* stats = getenv("POLY_STATS");
+    bool report_stats = (stats != NULL && strtoul(stats, NULL, 10) != 0);
+    const char* trace = getenv("POLY_TRACE");
+    if (report_stats || trace != NULL)
+    {
+        StatsStart(trace);
+    }
+
+    Stack s;
+    StackInit(&s);
+
+    int result = 0;
+    const char* path = (argc > 1) ? argv[1] : NULL;
+    bool read = true;
+    if (in_pipeline)
+    {
+        read = ExecutePipeline(&s, path);
+    }
+    else if (path != NULL)
+    {
+        read = ReadFile(path, RunLine, &s);
+    }
+    else
+    {
+        ReadStdin(RunLine, &s);
+    }
+    if (!read)
+    {
+        fprintf(stderr, "ERROR CANNOT READ %s\n", path);
+        result = 1;
+    }
+    if (report_stats)
+    {
+        ReportStats(stderr);
+    }
+    if (StatsEnabled() && !StatsFinish())
+    {
+        fprintf(stderr, "ERROR CANNOT WRITE %s\n", trace);
+        result = 1;
+    }
 
-    free(line);
     StackDestroy(&s);
-    return 0;
+    PolySetThreads(0);
+    return result;
 }
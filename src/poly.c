@@ -5,10 +5,15 @@
 */
 
 #include <assert.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "poly.h"
+#include "pool.h"
 
 /**
 Sprawdza, czy alokacja sie powiodla.
@@ -21,18 +26,400 @@ Sprawdza, czy alokacja sie powiodla.
 	} while (0)
 
 
+/**
+Rozmiar pojedynczego bloku pamieci areny w bajtach.
+*/
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/**
+Wyrównanie fragmentów pamieci przydzielanych z areny.
+*/
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+/**
+* Typ reprezentujacy blok pamieci areny.
+*/
+typedef struct ArenaChunk
+{
+    struct ArenaChunk* next; ///< wczesniej zaalokowany blok
+    size_t size; ///< rozmiar danych bloku w bajtach
+    size_t used; ///< liczba zajetych bajtów
+    max_align_t data[]; ///< dane bloku
+}   ArenaChunk;
+
+/**
+* Arena, z której przydzielana jest pamiec wielomianów.
+*/
+struct PolyArena
+{
+    ArenaChunk* chunks; ///< lista bloków, poczawszy od najnowszego
+    char* last; ///< ostatnio przydzielony fragment pamieci
+};
+
+/**
+Arena, z której przydzielana jest obecnie pamiec,
+lub NULL, jesli pamiec przydzielana jest przez malloc.
+Kazdy watek ma wlasna, zeby watki puli zawsze uzywaly malloc.
+*/
+static _Thread_local PolyArena* current_arena = NULL;
+
+/**
+ * Tworzy pusta arene.
+ * @return wskaznik na arene
+ */
+PolyArena* PolyArenaCreate(void)
+{
+    PolyArena* a = malloc(sizeof(PolyArena));
+    CHECK_PTR(a);
+    a->chunks = NULL;
+    a->last = NULL;
+    return a;
+}
+
+/**
+ * Zwalnia arene razem ze wszystkimi zbudowanymi w niej wielomianami.
+ * @param[in] a : arena
+ */
+void PolyArenaRelease(PolyArena* a)
+{
+    assert(a);
+    while (a->chunks != NULL)
+    {
+        ArenaChunk* next = a->chunks->next;
+        free(a->chunks);
+        a->chunks = next;
+    }
+    free(a);
+}
+
+/**
+ * Niszczy wszystkie wielomiany zbudowane w arenie,
+ * zachowujac ostatni blok pamieci do ponownego uzycia.
+ * @param[in] a : arena
+ */
+void PolyArenaReset(PolyArena* a)
+{
+    assert(a);
+    if (a->chunks == NULL)
+    {
+        return;
+    }
+    while (a->chunks->next != NULL)
+    {
+        ArenaChunk* next = a->chunks->next;
+        a->chunks->next = next->next;
+        free(next);
+    }
+    a->chunks->used = 0;
+    a->last = NULL;
+}
+
+/**
+ * Przydziela fragment pamieci z areny.
+ * @param[in] a : arena
+ * @param[in] size : rozmiar fragmentu w bajtach
+ * @return wskaznik na fragment pamieci
+ */
+void* PolyArenaAlloc(PolyArena* a, size_t size)
+{
+    assert(a);
+    size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if (a->chunks == NULL || a->chunks->size - a->chunks->used < size)
+    {
+        size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + chunk_size);
+        CHECK_PTR(chunk);
+        chunk->next = a->chunks;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        a->chunks = chunk;
+    }
+    a->last = (char*)a->chunks->data + a->chunks->used;
+    a->chunks->used += size;
+    return a->last;
+}
+
+/**
+* Powieksza fragment pamieci przydzielony z areny.
+* Jesli byl to ostatnio przydzielony fragment i w bloku jest miejsce,
+* powieksza go w miejscu, wpp. przydziela nowy i kopiuje zawartosc.
+* @param[in] a: arena
+* @param[in] ptr: fragment pamieci
+* @param[in] old_size: dotychczasowy rozmiar fragmentu
+* @param[in] new_size: nowy rozmiar fragmentu
+* @return wskaznik na powiekszony fragment
+*/
+static void* ArenaRealloc(PolyArena* a, void* ptr, size_t old_size, size_t new_size)
+{
+    if (ptr != NULL && ptr == a->last)
+    {
+        size_t offset = a->last - (char*)a->chunks->data;
+        size_t rounded = (new_size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+        if (a->chunks->size - offset >= rounded)
+        {
+            a->chunks->used = offset + rounded;
+            return ptr;
+        }
+    }
+    void* res = PolyArenaAlloc(a, new_size);
+    if (ptr != NULL)
+    {
+        memcpy(res, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return res;
+}
+
+/**
+* Przydziela pamiec z biezacej areny lub, jesli jej nie ma, przez malloc.
+* @param[in] size: rozmiar w bajtach
+* @return wskaznik na pamiec
+*/
+static void* PolyMalloc(size_t size)
+{
+    if (current_arena != NULL)
+    {
+        return PolyArenaAlloc(current_arena, size);
+    }
+    return malloc(size);
+}
+
+/**
+* Zmienia rozmiar pamieci przydzielonej przez PolyMalloc.
+* @param[in] ptr: wskaznik na pamiec
+* @param[in] old_size: dotychczasowy rozmiar w bajtach
+* @param[in] new_size: nowy rozmiar w bajtach
+* @return wskaznik na pamiec
+*/
+static void* PolyRealloc(void* ptr, size_t old_size, size_t new_size)
+{
+    if (current_arena != NULL)
+    {
+        return ArenaRealloc(current_arena, ptr, old_size, new_size);
+    }
+    return realloc(ptr, new_size);
+}
+
+/**
+* Zwalnia pamiec przydzielona przez PolyMalloc.
+* Pamiec z areny jest zwalniana dopiero razem z cala arena.
+* @param[in] ptr: wskaznik na pamiec
+*/
+static void PolyFree(void* ptr)
+{
+    if (current_arena == NULL)
+    {
+        free(ptr);
+    }
+}
+
+/**
+* Naglówek umieszczany w pamieci przed kazda tablica jednomianów wielomianu.
+* Tablice jednomianów sa niezmienne, dopóki sa wspóldzielone,
+* wiec kopia wielomianu moze wskazywac na te sama tablice.
+* Przechowuje tez leniwie wyliczany skrót wielomianu.
+*/
+typedef struct
+{
+    atomic_size_t refs; ///< liczba wielomianów wskazujacych na tablice
+    bool in_arena; ///< czy tablica zostala przydzielona z areny
+    atomic_size_t terms; ///< liczba wyrazów wielomianu lub 0, jesli nie jest wyliczona
+    _Atomic uint64_t hash; ///< skrót wielomianu, jesli terms > 0
+}   MonosHeader;
+
+/**
+* Zwraca naglówek tablicy jednomianów.
+* @param[in] arr: tablica jednomianów
+* @return wskaznik na naglówek
+*/
+static MonosHeader* MonosGetHeader(Mono* arr)
+{
+    return (MonosHeader*)arr - 1;
+}
+
+/**
+Liczba watków ustawiona funkcja PolySetThreads.
+*/
+static size_t poly_threads = 0;
+
+/**
+* Zwraca liczbe odwolan do tablicy jednomianów.
+* @param[in] arr: tablica jednomianów
+* @return liczba odwolan
+*/
+static size_t MonosRefs(Mono* arr)
+{
+    return atomic_load_explicit(&MonosGetHeader(arr)->refs, memory_order_acquire);
+}
+
+/**
+* Zwieksza liczbe odwolan do tablicy jednomianów.
+* Licznik jest zmieniany atomowo, bo kopie wielomianu moga zyc
+* w róznych watkach: w watkach puli i w kolejnych etapach potoku kalkulatora.
+* @param[in] arr: tablica jednomianów
+*/
+static void MonosRetain(Mono* arr)
+{
+    atomic_fetch_add_explicit(&MonosGetHeader(arr)->refs, 1, memory_order_relaxed);
+}
+
+/**
+* Zmniejsza liczbe odwolan do tablicy jednomianów.
+* @param[in] arr: tablica jednomianów
+* @return liczba pozostalych odwolan
+*/
+static size_t MonosRelease(Mono* arr)
+{
+    return atomic_fetch_sub_explicit(&MonosGetHeader(arr)->refs, 1, memory_order_acq_rel) - 1;
+}
+
+/**
+Minimalny rozmiar tablicy jednomianów, od którego przejscie po niej
+jest dzielone na zadania puli watków.
+*/
+#define PARALLEL_MONOS 1024
+
+/**
+Liczba zadan przypadajaca na jeden watek puli przy dzieleniu pracy.
+*/
+#define TASKS_PER_THREAD 4
+
+/**
+* Sprawdza, czy obliczenia moga byc wykonywane równolegle.
+* W arenie sa zawsze sekwencyjne, bo watki puli przydzielaja pamiec przez malloc.
+* @return bool
+*/
+static bool ParallelEnabled(void)
+{
+    return poly_threads > 1 && current_arena == NULL;
+}
+
+/**
+* Zadanie wykonujace funkcje dla fragmentu zakresu indeksów.
+*/
+typedef struct
+{
+    void (*body)(void*, size_t, size_t); ///< funkcja wywolywana dla fragmentu
+    void* ctx; ///< pierwszy argument funkcji
+    size_t beg; ///< poczatek fragmentu
+    size_t end; ///< koniec fragmentu
+}   RangeTask;
+
+/**
+* Wykonuje zadanie RangeTask.
+* @param[in] arg: zadanie
+*/
+static void RunRangeTask(void* arg)
+{
+    RangeTask* t = arg;
+    t->body(t->ctx, t->beg, t->end);
+}
+
+/**
+* Wywoluje body(ctx, beg, end) dla rozlacznych fragmentów pokrywajacych
+* zakres [0, size). Duze zakresy dzieli miedzy watki puli, a male
+* przetwarza w calosci w biezacym watku.
+* @param[in] size: rozmiar zakresu
+* @param[in] body: funkcja przetwarzajaca fragment
+* @param[in] ctx: pierwszy argument funkcji
+*/
+static void ParallelFor(size_t size, void (*body)(void*, size_t, size_t), void* ctx)
+{
+    if (!ParallelEnabled() || size < PARALLEL_MONOS)
+    {
+        body(ctx, 0, size);
+        return;
+    }
+    size_t num_tasks = PoolThreads() * TASKS_PER_THREAD;
+    RangeTask* tasks = malloc(num_tasks * sizeof(RangeTask));
+    CHECK_PTR(tasks);
+    PoolGroup group;
+    PoolGroupInit(&group);
+    for (size_t k = 0; k < num_tasks; k++)
+    {
+        tasks[k] = (RangeTask) {.body = body, .ctx = ctx,
+            .beg = size * k / num_tasks, .end = size * (k + 1) / num_tasks};
+        PoolSpawn(&group, RunRangeTask, &tasks[k]);
+    }
+    PoolWait(&group);
+    free(tasks);
+}
+
+/**
+* Alokuje tablice jednomianów z jednym odwolaniem.
+* @param[in] count: liczba jednomianów
+* @return tablica jednomianów
+*/
+static Mono* MonosAlloc(size_t count)
+{
+    MonosHeader* header = PolyMalloc(sizeof(MonosHeader) + count * sizeof(Mono));
+    CHECK_PTR(header);
+    atomic_init(&header->refs, 1);
+    header->in_arena = (current_arena != NULL);
+    atomic_init(&header->terms, 0);
+    atomic_init(&header->hash, 0);
+    return (Mono*)(header + 1);
+}
+
+/**
+* Zmienia rozmiar tablicy jednomianów, która nie jest wspóldzielona.
+* @param[in] arr: tablica jednomianów
+* @param[in] old_count: dotychczasowa liczba jednomianów
+* @param[in] new_count: nowa liczba jednomianów
+* @return tablica jednomianów
+*/
+static Mono* MonosRealloc(Mono* arr, size_t old_count, size_t new_count)
+{
+    assert(MonosRefs(arr) == 1);
+    MonosHeader* header = PolyRealloc(MonosGetHeader(arr),
+        sizeof(MonosHeader) + old_count * sizeof(Mono),
+        sizeof(MonosHeader) + new_count * sizeof(Mono));
+    CHECK_PTR(header);
+    return (Mono*)(header + 1);
+}
+
+/**
+* Zwalnia pamiec tablicy jednomianów, która nie jest wspóldzielona,
+* bez niszczenia jej zawartosci.
+* @param[in] arr: tablica jednomianów
+*/
+static void MonosFree(Mono* arr)
+{
+    assert(MonosRefs(arr) == 1);
+    PolyFree(MonosGetHeader(arr));
+}
+
+/**
+* Niszczy jednomiany z fragmentu tablicy.
+* @param[in] arr: tablica jednomianów
+* @param[in] beg: poczatek fragmentu
+* @param[in] end: koniec fragmentu
+*/
+static void DestroyMonosRange(void* arr, size_t beg, size_t end)
+{
+    Mono* monos = arr;
+    for (size_t i = beg; i < end; i++)
+    {
+        MonoDestroy(&monos[i]);
+    }
+}
+
 /**
  * Zwalnia tablice jednomianów i niszczy jej zawartosc.
+ * Jesli tablica jest wspóldzielona, jedynie zmniejsza licznik odwolan.
+ * Zawartosc duzych tablic jest niszczona równolegle.
  * @param[in] arr: wskaznik na tablice wielomianów
  * @param[in] size: rozmiar tablicy
  */
 static void FreeArrOfMonos(Mono** arr, size_t size)
 {
-    for (size_t i = 0; i < size; i++)
+    if (current_arena != NULL || MonosRelease(*arr) > 0)
     {
-        MonoDestroy(&((*arr)[i]));
+        // Pamiec z areny zostanie zwolniona razem z arena.
+        *arr = NULL;
+        return;
     }
-    free(*arr);
+    ParallelFor(size, DestroyMonosRange, *arr);
+    PolyFree(MonosGetHeader(*arr));
     *arr = NULL;
 }
 
@@ -52,7 +439,11 @@ void PolyDestroy(Poly *p)
 
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Robi kopię wielomianu.
+ * Kopia wspóldzieli z oryginalem tablice jednomianów, wiec dziala w czasie
+ * stalym. W arenie robi pelna, gleboka kopie, zeby wynik byl w niej
+ * w calosci. Poza arena gleboko kopiuje tablice przydzielone z areny,
+ * zeby kopia przetrwala jej zwolnienie.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
@@ -68,8 +459,13 @@ Poly PolyClone(const Poly* p)
     }
     Poly q;
     q.size = p->size;
-    q.arr = malloc((q.size)*sizeof(Mono));
-    CHECK_PTR(q.arr);
+    if (current_arena == NULL && !MonosGetHeader(p->arr)->in_arena)
+    {
+        MonosRetain(p->arr);
+        q.arr = p->arr;
+        return q;
+    }
+    q.arr = MonosAlloc(q.size);
     for (size_t i = 0; i < p->size; i++)
     {
         q.arr[i] = MonoClone(&(p->arr[i]));
@@ -77,6 +473,37 @@ Poly PolyClone(const Poly* p)
     return q;
 }
 
+/**
+* Zapewnia, ze tablica jednomianów wielomianu nie jest wspóldzielona,
+* aby mozna ja bylo zmieniac w miejscu.
+* Wspóldzielona tablice zastepuje jej kopia, której jednomiany
+* wspóldziela wspólczynniki z oryginalem.
+* @param[in] p: wielomian
+*/
+static void PolyMakeUnique(Poly* p)
+{
+    if (PolyIsCoeff(p))
+    {
+        return;
+    }
+    if (MonosRefs(p->arr) == 1)
+    {
+        // Tablica zaraz sie zmieni, wiec jej skrót przestaje byc aktualny.
+        atomic_store_explicit(&MonosGetHeader(p->arr)->terms, 0, memory_order_relaxed);
+        return;
+    }
+    Mono* arr = MonosAlloc(p->size);
+    for (size_t i = 0; i < p->size; i++)
+    {
+        arr[i] = MonoClone(&(p->arr[i]));
+    }
+    // Inny watek mógl w tym czasie zrobic to samo z ta tablica,
+    // wiec oddaje sie odwolanie tak, zeby ostatni ja zwolnil.
+    Poly shared = *p;
+    p->arr = arr;
+    PolyDestroy(&shared);
+}
+
 
 /**
  * Sprawdza, czy liczba jest potega dwójki.
@@ -113,7 +540,7 @@ static void InsertEnd(Mono** array, Mono* m, size_t size)
     if (size != 0 && IsPowerOfTwo(size))
     {
         // Powieksza tablice dwukrotnie gdy jej rozmiar jest potega dwójki.
-        (*array) = realloc((*array), (2*size) * sizeof(Mono));
+        (*array) = MonosRealloc((*array), size, 2*size);
         CHECK_PTR((*array));
     }
     (*array)[size] = *m;
@@ -132,7 +559,7 @@ static void CloneAndInsert(Poly* p, const Poly* p_original, const Mono* mono_to_
 {
     assert(!PolyIsCoeff(p_original));
     p->size = p_original->size + 1;
-    p->arr = malloc(p->size * sizeof(Mono));
+    p->arr = MonosAlloc(p->size);
     p->arr[0] = MonoClone(mono_to_insert);
     for (size_t i = 1; i < p->size; i++)
     {
@@ -165,7 +592,7 @@ static void PolyReduce(Poly *p)
     }
     else if (p->size == 0)
     {
-        free(p->arr);
+        MonosFree(p->arr);
         *p = PolyZero();
     }
     else if (PolyUnreduced(p))
@@ -199,6 +626,82 @@ static int CompareMonos(Mono* a, Mono *b)
     }
 }
 
+/**
+* Miesza bity liczby (funkcja koncowa generatora SplitMix64).
+* @param[in] x: liczba
+* @return wymieszana liczba
+*/
+static uint64_t MixBits(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+* Skrót i liczba wyrazów wielomianu.
+*/
+typedef struct
+{
+    uint64_t hash; ///< skrót wielomianu
+    size_t terms; ///< liczba wyrazów wielomianu
+}   PolySummaryValue;
+
+/**
+* Zwraca skrót i liczbe wyrazów wielomianu niebedacego wspólczynnikiem,
+* wyliczajac je i zapamietujac w naglówku tablicy jednomianów,
+* jesli nie sa jeszcze znane.
+* Tablice moga wspóldzielic kopie uzywane w róznych watkach, wiec skrót
+* jest zapisywany przed opublikowaniem liczby wyrazów (release), a czytany
+* po jej odczytaniu (acquire). Dwa watki moga wyliczyc te same wartosci
+* jednoczesnie, co jest nieszkodliwe.
+* @param[in] p: wielomian
+* @return skrót i liczba wyrazów
+*/
+static PolySummaryValue PolySummary(const Poly* p)
+{
+    assert(!PolyIsCoeff(p));
+    MonosHeader* header = MonosGetHeader(p->arr);
+    PolySummaryValue res;
+    res.terms = atomic_load_explicit(&header->terms, memory_order_acquire);
+    if (res.terms > 0)
+    {
+        res.hash = atomic_load_explicit(&header->hash, memory_order_relaxed);
+        return res;
+    }
+    res.hash = MixBits(p->size);
+    for (size_t i = 0; i < p->size; i++)
+    {
+        res.hash = MixBits(res.hash + (uint64_t)p->arr[i].exp);
+        res.hash = MixBits(res.hash ^ PolyHash(&(p->arr[i].p)));
+        res.terms += PolyIsCoeff(&(p->arr[i].p)) ? 1 :
+            PolySummary(&(p->arr[i].p)).terms;
+    }
+    atomic_store_explicit(&header->hash, res.hash, memory_order_relaxed);
+    atomic_store_explicit(&header->terms, res.terms, memory_order_release);
+    return res;
+}
+
+/**
+ * Zwraca 64-bitowy skrót wielomianu zależny tylko od jego wartości.
+ * Dla wielomianów niebędących współczynnikami skrót jest wyliczany raz
+ * i zapamiętywany razem z tablicą jednomianów.
+ * @param[in] p : wielomian
+ * @return skrót wielomianu
+ */
+uint64_t PolyHash(const Poly* p)
+{
+    assert(p);
+    if (PolyIsCoeff(p))
+    {
+        return MixBits((uint64_t)p->coeff);
+    }
+    return PolySummary(p).hash;
+}
+
 /**
  * Sprawdza równość dwóch wielomianów.
  * @param[in] p : wielomian @f$p@f$
@@ -222,6 +725,18 @@ bool PolyIsEq(const Poly* p, const Poly* q)
         {
             return false;
         }
+        if (p->arr == q->arr)
+        {
+            // Kopie wspóldzielace tablice jednomianów.
+            return true;
+        }
+        PolySummaryValue p_summary = PolySummary(p);
+        PolySummaryValue q_summary = PolySummary(q);
+        if (p_summary.hash != q_summary.hash ||
+            p_summary.terms != q_summary.terms)
+        {
+            return false;
+        }
         for (unsigned int i = 0; i < p->size; i++)
         {
             if (p->arr[i].exp != q->arr[i].exp)
@@ -277,8 +792,7 @@ static Poly AddCoeffToZeroExp(const Poly* p, const Poly* q)
         drugiego wielomianu o wykladniku 0 jest wielomianem zerowym. */
         Poly r;
         r.size = q->size - 1;
-        r.arr = malloc(sizeof(Mono));
-        CHECK_PTR(r.arr);
+        r.arr = MonosAlloc(1);
         Mono temp_mono;
         for (size_t i = 1; i < q->size; i++)
         {
@@ -290,8 +804,7 @@ static Poly AddCoeffToZeroExp(const Poly* p, const Poly* q)
 
     Poly r;
     r.size = q->size;
-    r.arr = malloc(r.size*sizeof(Mono));
-    CHECK_PTR(r.arr);
+    r.arr = MonosAlloc(r.size);
     r.arr[0].p = PolyAdd(&q_zero_exp.p, p);
     r.arr[0].exp = q_zero_exp.exp;
     for (size_t i = 1; i < r.size; i++)
@@ -366,32 +879,31 @@ static void InsertClone(const Poly* p, size_t* i, Poly* r)
 }
 
 /**
-* Dodaje dwa wielomiany, z których zaden nie jest wspólczynnikowy.
+* Scala fragment p->arr[i, i_end) z fragmentem q->arr[j, j_end),
+* dopisujac sumy jednomianów na koniec tablicy wielomianu r.
 * @param[in] p: wielomian
+* @param[in] i: poczatek fragmentu p
+* @param[in] i_end: koniec fragmentu p
 * @param[in] q: wielomian
-* @return wielomian p+q
+* @param[in] j: poczatek fragmentu q
+* @param[in] j_end: koniec fragmentu q
+* @param[in] r: wielomian wynikowy
 */
-static Poly AddTwoNotEmptyPolys(const Poly* p, const Poly* q)
+static void AddMonosRange(const Poly* p, size_t i, size_t i_end,
+                          const Poly* q, size_t j, size_t j_end, Poly* r)
 {
-    assert(p && q);
-    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
-    Poly r;
-    r.size = 0;
-    r.arr = malloc(sizeof(Mono));
-    CHECK_PTR(r.arr);
-    size_t i = 0, j = 0;
-    while (i < p->size || j < q->size)
+    while (i < i_end || j < j_end)
     {
         /*
         To MergeSort jednomianów tych wielomianów,
         gdy napotyka na jednomiany o tych samych potegach, scala je. */
-        if (i >= p->size)
+        if (i >= i_end)
         {
-            InsertClone(q, &j, &r);
+            InsertClone(q, &j, r);
         }
-        else if (j >= q->size)
+        else if (j >= j_end)
         {
-            InsertClone(p, &i, &r);
+            InsertClone(p, &i, r);
         }
         else if (p->arr[i].exp == q->arr[j].exp)
         {
@@ -399,46 +911,188 @@ static Poly AddTwoNotEmptyPolys(const Poly* p, const Poly* q)
             if (!(PolyIsCoeff(&s) && s.coeff == 0))
             {
                 Mono temp = MonoFromPoly(&s, p->arr[i].exp);
-                InsertEnd((&r.arr), &temp, r.size);
-                r.size++;
+                InsertEnd((&r->arr), &temp, r->size);
+                r->size++;
             }
             i++;
             j++;
         }
         else if (p->arr[i].exp < q->arr[j].exp)
         {
-            InsertClone(p, &i, &r);
+            InsertClone(p, &i, r);
         }
         else
         {
-            InsertClone(q, &j, &r);
+            InsertClone(q, &j, r);
         }
     }
-    PolyReduce(&r);
-    return r;
 }
 
-
-
 /**
- * Dodaje dwa wielomiany.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @return @f$p + q@f$
- */
-Poly PolyAdd(const Poly* p, const Poly* q)
+* Znajduje pierwszy jednomian wielomianu o wykladniku nie mniejszym niz dany.
+* @param[in] q: wielomian niebedacy wspólczynnikiem
+* @param[in] exp: wykladnik
+* @return numer jednomianu lub q->size, jesli nie ma takiego
+*/
+static size_t LowerBoundExp(const Poly* q, long long exp)
 {
-    assert(p && q);
-    if (PolyIsCoeff(p) && PolyIsCoeff(q))
-    {
-        return AddTwoEmptyPolys(p, q);
-    }
-    else if (PolyIsCoeff(p))
+    size_t beg = 0;
+    size_t end = q->size;
+    while (beg < end)
     {
-        return AddEmptyPoly(p, q);
+        size_t mid = beg + (end - beg) / 2;
+        if (q->arr[mid].exp < exp)
+        {
+            beg = mid + 1;
+        }
+        else
+        {
+            end = mid;
+        }
     }
-    else if (PolyIsCoeff(q))
-    {
+    return beg;
+}
+
+/**
+* Laczy kolejne czesci wyniku, zawierajace jednomiany z rosnacych,
+* rozlacznych zakresów wykladników, w jeden wielomian.
+* Przyjmuje na wlasnosc zawartosc czesci.
+* @param[in] parts: czesci wyniku
+* @param[in] count: liczba czesci
+* @return wielomian
+*/
+static Poly ConcatParts(Poly* parts, size_t count)
+{
+    Poly r;
+    r.size = 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        r.size += parts[k].size;
+    }
+    r.arr = MonosAlloc(r.size);
+    size_t pos = 0;
+    for (size_t k = 0; k < count; k++)
+    {
+        memcpy(&r.arr[pos], parts[k].arr, parts[k].size * sizeof(Mono));
+        pos += parts[k].size;
+        MonosFree(parts[k].arr);
+    }
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+* Zadanie dodajace fragmenty dwóch wielomianów.
+*/
+typedef struct
+{
+    const Poly* p; ///< wielomian
+    const Poly* q; ///< wielomian
+    size_t i; ///< poczatek fragmentu p
+    size_t i_end; ///< koniec fragmentu p
+    size_t j; ///< poczatek fragmentu q
+    size_t j_end; ///< koniec fragmentu q
+    Poly* r; ///< wynik: suma fragmentów
+}   AddRangeTask;
+
+/**
+* Wykonuje zadanie AddRangeTask.
+* @param[in] arg: zadanie
+*/
+static void AddRange(void* arg)
+{
+    AddRangeTask* t = arg;
+    t->r->size = 0;
+    t->r->arr = MonosAlloc(1);
+    AddMonosRange(t->p, t->i, t->i_end, t->q, t->j, t->j_end, t->r);
+}
+
+/**
+* Dodaje dwa duze wielomiany, z których zaden nie jest wspólczynnikowy,
+* dzielac dluzszy z nich na równe fragmenty, a krótszy w miejscach
+* odpowiadajacych wykladnikom na granicach tych fragmentów.
+* Fragmenty sa dodawane przez osobne zadania puli watków.
+* @param[in] p: wielomian
+* @param[in] q: wielomian
+* @return wielomian p+q
+*/
+static Poly AddParallel(const Poly* p, const Poly* q)
+{
+    if (p->size < q->size)
+    {
+        const Poly* temp = p;
+        p = q;
+        q = temp;
+    }
+    size_t num_tasks = PoolThreads() * TASKS_PER_THREAD;
+    AddRangeTask* tasks = malloc(num_tasks * sizeof(AddRangeTask));
+    Poly* parts = malloc(num_tasks * sizeof(Poly));
+    CHECK_PTR(tasks);
+    CHECK_PTR(parts);
+    PoolGroup group;
+    PoolGroupInit(&group);
+    size_t j = 0;
+    for (size_t k = 0; k < num_tasks; k++)
+    {
+        size_t i = p->size * k / num_tasks;
+        size_t i_end = p->size * (k + 1) / num_tasks;
+        size_t j_end = (k + 1 == num_tasks) ? q->size : LowerBoundExp(q, p->arr[i_end].exp);
+        tasks[k] = (AddRangeTask) {.p = p, .q = q, .i = i, .i_end = i_end,
+            .j = j, .j_end = j_end, .r = &parts[k]};
+        PoolSpawn(&group, AddRange, &tasks[k]);
+        j = j_end;
+    }
+    PoolWait(&group);
+    free(tasks);
+
+    Poly r = ConcatParts(parts, num_tasks);
+    free(parts);
+    return r;
+}
+
+/**
+* Dodaje dwa wielomiany, z których zaden nie jest wspólczynnikowy.
+* @param[in] p: wielomian
+* @param[in] q: wielomian
+* @return wielomian p+q
+*/
+static Poly AddTwoNotEmptyPolys(const Poly* p, const Poly* q)
+{
+    assert(p && q);
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    if (ParallelEnabled() && p->size + q->size >= PARALLEL_MONOS)
+    {
+        return AddParallel(p, q);
+    }
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(1);
+    AddMonosRange(p, 0, p->size, q, 0, q->size, &r);
+    PolyReduce(&r);
+    return r;
+}
+
+
+
+/**
+ * Dodaje dwa wielomiany.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAdd(const Poly* p, const Poly* q)
+{
+    assert(p && q);
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    {
+        return AddTwoEmptyPolys(p, q);
+    }
+    else if (PolyIsCoeff(p))
+    {
+        return AddEmptyPoly(p, q);
+    }
+    else if (PolyIsCoeff(q))
+    {
         return AddEmptyPoly(q, p);
     }
     else
@@ -447,8 +1101,34 @@ Poly PolyAdd(const Poly* p, const Poly* q)
     }
 }
 
+/**
+* Argumenty negowania fragmentu wielomianu.
+*/
+typedef struct
+{
+    const Poly* p; ///< negowany wielomian
+    Poly* res; ///< wielomian wynikowy z zaalokowana tablica jednomianów
+}   NegTask;
+
+/**
+* Neguje jednomiany z fragmentu tablicy wielomianu.
+* @param[in] arg: zadanie NegTask
+* @param[in] beg: poczatek fragmentu
+* @param[in] end: koniec fragmentu
+*/
+static void NegRange(void* arg, size_t beg, size_t end)
+{
+    NegTask* t = arg;
+    for (size_t i = beg; i < end; i++)
+    {
+        t->res->arr[i].exp = t->p->arr[i].exp;
+        t->res->arr[i].p = PolyNeg(&(t->p->arr[i].p));
+    }
+}
+
 /**
  * Zwraca przeciwny wielomian.
+ * Jednomiany duzych wielomianów sa negowane równolegle.
  * @param[in] p : wielomian @f$p@f$
  * @return @f$-p@f$
  */
@@ -463,16 +1143,243 @@ Poly PolyNeg(const Poly *p)
     }
     Poly res;
     res.size = p->size;
-    res.arr = malloc(res.size*sizeof(Mono));
-    CHECK_PTR(res.arr);
-    for (size_t i = 0; i < p->size; i++)
+    res.arr = MonosAlloc(res.size);
+    NegTask task = {.p = p, .res = &res};
+    ParallelFor(p->size, NegRange, &task);
+    return res;
+}
+
+
+/**
+* Dodaje wspólczynnik do wielomianu, który nie jest wspólczynnikowy.
+* Przyjmuje na wlasnosc zawartosc wielomianu q.
+* @param[in] c: wspólczynnik
+* @param[in] q: wielomian
+* @return wielomian c+q
+*/
+static Poly AddCoeffOwned(poly_coeff_t c, Poly* q)
+{
+    assert(!PolyIsCoeff(q));
+    PolyMakeUnique(q);
+    Poly r = *q;
+    if (r.arr[0].exp == 0)
+    {
+        Poly coeff = PolyFromCoeff(c);
+        r.arr[0].p = PolyAddOwned(&coeff, &r.arr[0].p);
+        if (PolyIsZero(&r.arr[0].p))
+        {
+            // Jednomian o wykladniku 0 sie wyzerowal, wiec go usuwa.
+            memmove(r.arr, r.arr + 1, (r.size - 1) * sizeof(Mono));
+            r.size--;
+        }
+    }
+    else if (c != 0)
+    {
+        r.arr = MonosRealloc(r.arr, r.size, r.size + 1);
+        memmove(r.arr + 1, r.arr, r.size * sizeof(Mono));
+        Poly coeff = PolyFromCoeff(c);
+        r.arr[0] = MonoFromPoly(&coeff, 0);
+        r.size++;
+    }
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+* Dodaje dwa wielomiany, z których zaden nie jest wspólczynnikowy.
+* Przenosi jednomiany do wyniku zamiast je klonowac.
+* Przyjmuje na wlasnosc zawartosc wielomianów p i q.
+* @param[in] p: wielomian
+* @param[in] q: wielomian
+* @return wielomian p+q
+*/
+static Poly AddTwoNotEmptyPolysOwned(Poly* p, Poly* q)
+{
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    PolyMakeUnique(p);
+    PolyMakeUnique(q);
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(p->size + q->size);
+    size_t i = 0, j = 0;
+    while (i < p->size || j < q->size)
+    {
+        if (j >= q->size || (i < p->size && p->arr[i].exp < q->arr[j].exp))
+        {
+            r.arr[r.size++] = p->arr[i++];
+        }
+        else if (i >= p->size || q->arr[j].exp < p->arr[i].exp)
+        {
+            r.arr[r.size++] = q->arr[j++];
+        }
+        else
+        {
+            Poly s = PolyAddOwned(&(p->arr[i].p), &(q->arr[j].p));
+            if (!PolyIsZero(&s))
+            {
+                r.arr[r.size++] = MonoFromPoly(&s, p->arr[i].exp);
+            }
+            i++;
+            j++;
+        }
+    }
+    MonosFree(p->arr);
+    MonosFree(q->arr);
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+ * Dodaje dwa wielomiany.
+ * Przejmuje na własność zawartość wielomianów @p p i @p q.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddOwned(Poly *p, Poly *q)
+{
+    assert(p && q);
+    Poly res;
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    {
+        res = AddTwoEmptyPolys(p, q);
+    }
+    else if (PolyIsCoeff(p))
+    {
+        res = AddCoeffOwned(p->coeff, q);
+    }
+    else if (PolyIsCoeff(q))
+    {
+        res = AddCoeffOwned(q->coeff, p);
+    }
+    else
+    {
+        res = AddTwoNotEmptyPolysOwned(p, q);
+    }
+    *p = PolyZero();
+    *q = PolyZero();
+    return res;
+}
+
+/**
+* Neguje w miejscu jednomiany z fragmentu tablicy.
+* @param[in] arr: tablica jednomianów, która nie jest wspóldzielona
+* @param[in] beg: poczatek fragmentu
+* @param[in] end: koniec fragmentu
+*/
+static void NegOwnedRange(void* arr, size_t beg, size_t end)
+{
+    Mono* monos = arr;
+    for (size_t i = beg; i < end; i++)
+    {
+        monos[i].p = PolyNegOwned(&(monos[i].p));
+    }
+}
+
+/**
+ * Zwraca przeciwny wielomian, negując współczynniki w miejscu.
+ * Przejmuje na własność zawartość wielomianu @p p.
+ * @param[in] p : wielomian @f$p@f$
+ * @return @f$-p@f$
+ */
+Poly PolyNegOwned(Poly *p)
+{
+    assert(p);
+    Poly res = *p;
+    if (PolyIsCoeff(&res))
+    {
+        res.coeff = -res.coeff;
+    }
+    else
     {
-        res.arr[i].exp = p->arr[i].exp;
-        res.arr[i].p = PolyNeg(&(p->arr[i].p));
+        PolyMakeUnique(&res);
+        ParallelFor(res.size, NegOwnedRange, res.arr);
     }
+    *p = PolyZero();
     return res;
 }
 
+/**
+ * Odejmuje wielomian od wielomianu.
+ * Przejmuje na własność zawartość wielomianów @p p i @p q.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p - q@f$
+ */
+Poly PolySubOwned(Poly *p, Poly *q)
+{
+    assert(p && q);
+    Poly q_neg = PolyNegOwned(q);
+    return PolyAddOwned(p, &q_neg);
+}
+
+/**
+* Klonuje i-ty jednomian wielomianu q ze zanegowanym wspólczynnikiem,
+* po czym dodaje go do tablicy wielomianu r.
+* @param[in] q: wielomian
+* @param[in] j: numer klonowanego jednomianu
+* @param[in] r: wielomian
+*/
+static void InsertNegClone(const Poly* q, size_t* j, Poly* r)
+{
+    Poly neg = PolyNeg(&(q->arr[(*j)].p));
+    Mono temp_mono = MonoFromPoly(&neg, q->arr[(*j)].exp);
+    InsertEnd((&r->arr), &temp_mono, r->size);
+    r->size++;
+    (*j)++;
+}
+
+/**
+* Odejmuje dwa wielomiany, z których zaden nie jest wspólczynnikowy.
+* Neguje wspólczynniki jednomianów q w trakcie scalania,
+* bez tworzenia calego wielomianu -q.
+* @param[in] p: wielomian
+* @param[in] q: wielomian
+* @return wielomian p-q
+*/
+static Poly SubTwoNotEmptyPolys(const Poly* p, const Poly* q)
+{
+    assert(p && q);
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(1);
+    size_t i = 0, j = 0;
+    while (i < p->size || j < q->size)
+    {
+        if (i >= p->size)
+        {
+            InsertNegClone(q, &j, &r);
+        }
+        else if (j >= q->size)
+        {
+            InsertClone(p, &i, &r);
+        }
+        else if (p->arr[i].exp == q->arr[j].exp)
+        {
+            Poly s = PolySub(&(p->arr[i].p), &(q->arr[j].p));
+            if (!PolyIsZero(&s))
+            {
+                Mono temp = MonoFromPoly(&s, p->arr[i].exp);
+                InsertEnd((&r.arr), &temp, r.size);
+                r.size++;
+            }
+            i++;
+            j++;
+        }
+        else if (p->arr[i].exp < q->arr[j].exp)
+        {
+            InsertClone(p, &i, &r);
+        }
+        else
+        {
+            InsertNegClone(q, &j, &r);
+        }
+    }
+    PolyReduce(&r);
+    return r;
+}
+
 /**
  * Odejmuje wielomian od wielomianu.
  * @param[in] p : wielomian @f$p@f$
@@ -482,10 +1389,24 @@ Poly PolyNeg(const Poly *p)
 Poly PolySub(const Poly* p, const Poly* q)
 {
     assert(p && q);
-    Poly q_neg = PolyNeg(q);
-    Poly res = PolyAdd(p, &q_neg);
-    PolyDestroy(&q_neg);
-    return res;
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    {
+        return PolyFromCoeff(p->coeff - q->coeff);
+    }
+    else if (PolyIsCoeff(p))
+    {
+        Poly q_neg = PolyNeg(q);
+        return AddCoeffOwned(p->coeff, &q_neg);
+    }
+    else if (PolyIsCoeff(q))
+    {
+        Poly q_neg = PolyFromCoeff(-q->coeff);
+        return PolyAdd(p, &q_neg);
+    }
+    else
+    {
+        return SubTwoNotEmptyPolys(p, q);
+    }
 }
 
 /**
@@ -546,7 +1467,7 @@ Poly PolyAddMonos(size_t count, const Mono monos[])
     {
         return PolyZero();
     }
-    Mono* monos_sorted = malloc(count*sizeof(Mono));
+    Mono* monos_sorted = PolyMalloc(count*sizeof(Mono));
     CHECK_PTR(monos_sorted);
 
     for (size_t i = 0; i < count; i++)
@@ -555,28 +1476,15 @@ Poly PolyAddMonos(size_t count, const Mono monos[])
     }
     qsort(monos_sorted, count, sizeof(Mono),
      (int(*)(void const*, void const*))CompareMonos);
-    Mono* new_monos = malloc(sizeof(Mono));
-    CHECK_PTR(new_monos);
+    Mono* new_monos = MonosAlloc(1);
 
     size_t new_count = 0;
     MergeMonos(monos_sorted, &new_monos, count, &new_count);
-    if (new_count == 0)
-    {
-        free(monos_sorted);
-        free(new_monos);
-        return PolyZero();
-    }
+    PolyFree(monos_sorted);
 
     Poly p;
     p.size = new_count;
-    p.arr = malloc(new_count*sizeof(Mono));
-    CHECK_PTR(p.arr);
-    for (size_t i = 0; i < new_count; i++)
-    {
-        p.arr[i] = new_monos[i];
-    }
-    free(monos_sorted);
-    free(new_monos);
+    p.arr = new_monos;
     PolyReduce(&p);
     return p;
 }
@@ -617,8 +1525,7 @@ static Poly PolyMulWithCoeff(const Poly* p, const Poly* q)
     }
     Poly r; // Wynikowy wielomian.
     r.size = 0;
-    r.arr = malloc(sizeof(Mono));
-    CHECK_PTR(r.arr);
+    r.arr = MonosAlloc(1);
     for (size_t i = 0; i < p->size; i++)
     {
         // Przechodzi po kolei po wszystkich jego jednomianach i je wymnaza.
@@ -638,7 +1545,7 @@ static Poly PolyMulWithCoeff(const Poly* p, const Poly* q)
     }
     if (r.size == 0)
     {
-        free(r.arr);
+        MonosFree(r.arr);
         return PolyZero();
     }
     PolyReduce(&r);
@@ -660,6 +1567,333 @@ static Mono MulMonos(Mono *a, Mono *b)
     return res;
 }
 
+/**
+* Typ reprezentujacy element kopca uzywanego przy mnozeniu wielomianów.
+* Odpowiada iloczynowi i-tego jednomianu pierwszego wielomianu
+* oraz j-tego jednomianu drugiego wielomianu.
+*/
+typedef struct
+{
+    poly_exp_t exp; ///< wykladnik iloczynu jednomianów
+    size_t i; ///< numer jednomianu pierwszego wielomianu
+    size_t j; ///< numer jednomianu drugiego wielomianu
+}   HeapNode;
+
+/**
+* Wstawia element do kopca minimalnego (wzgledem wykladników).
+* Kopiec musi miec zaalokowane miejsce na nowy element.
+* @param[in] heap: tablica bedaca kopcem
+* @param[in] heap_size: wskaznik na liczbe elementów kopca
+* @param[in] node: wstawiany element
+*/
+static void HeapPush(HeapNode* heap, size_t* heap_size, HeapNode node)
+{
+    size_t k = (*heap_size)++;
+    while (k > 0 && heap[(k - 1) / 2].exp > node.exp)
+    {
+        heap[k] = heap[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    heap[k] = node;
+}
+
+/**
+* Usuwa z kopca minimalnego element o najmniejszym wykladniku.
+* @param[in] heap: niepusta tablica bedaca kopcem
+* @param[in] heap_size: wskaznik na liczbe elementów kopca
+* @return usuniety element
+*/
+static HeapNode HeapPop(HeapNode* heap, size_t* heap_size)
+{
+    assert(*heap_size > 0);
+    HeapNode res = heap[0];
+    HeapNode last = heap[--(*heap_size)];
+    size_t k = 0;
+    while (2 * k + 1 < *heap_size)
+    {
+        size_t child = 2 * k + 1;
+        if (child + 1 < *heap_size && heap[child + 1].exp < heap[child].exp)
+        {
+            child++;
+        }
+        if (heap[child].exp >= last.exp)
+        {
+            break;
+        }
+        heap[k] = heap[child];
+        k = child;
+    }
+    heap[k] = last;
+    return res;
+}
+
+/**
+* Dodaje do tablicy wynikowej jednomian, jesli nie jest zerowy.
+* W przeciwnym przypadku go usuwa.
+* Przyjmuje na wlasnosc zawartosc jednomianu m.
+* @param[in] r: wielomian wynikowy
+* @param[in] m: jednomian
+*/
+static void InsertIfNotZero(Poly* r, Mono* m)
+{
+    if (PolyIsZero(&m->p))
+    {
+        MonoDestroy(m);
+        return;
+    }
+    InsertEnd(&r->arr, m, r->size);
+    r->size++;
+}
+
+/**
+* Dolacza iloczyn jednomianów do biezaco scalanego jednomianu wyniku,
+* jesli maja ten sam wykladnik. W przeciwnym przypadku dopisuje biezacy
+* jednomian do wyniku i zastepuje go iloczynem.
+* Przyjmuje na wlasnosc zawartosc jednomianu m.
+* @param[in] r: wielomian wynikowy
+* @param[in] current: biezaco scalany jednomian
+* @param[in] m: iloczyn jednomianów
+*/
+static void MergeProduct(Poly* r, Mono* current, Mono* m)
+{
+    if (m->exp == current->exp)
+    {
+        current->p = PolyAddOwned(&current->p, &m->p);
+    }
+    else
+    {
+        InsertIfNotZero(r, current);
+        *current = *m;
+    }
+}
+
+/**
+* Mnozy dwa wielomiany, z których zaden nie jest wspólczynnikowy.
+* Iloczyny jednomianów wyznacza w kolejnosci rosnacych wykladników
+* za pomoca kopca i od razu scala te o równych wykladnikach,
+* dzieki czemu nie trzeba ich sortowac.
+* Kopiec zawiera co najwyzej jeden element dla kazdego jednomianu
+* krótszego z wielomianów.
+* @param[in] p: wielomian
+* @param[in] q: wielomian
+* @return wielomian p*q
+*/
+static Poly MulTwoNotEmptyPolys(const Poly* p, const Poly* q)
+{
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    if (p->size > q->size)
+    {
+        const Poly* temp = p;
+        p = q;
+        q = temp;
+    }
+    HeapNode* heap = PolyMalloc(p->size * sizeof(HeapNode));
+    CHECK_PTR(heap);
+    size_t heap_size = 0;
+    HeapPush(heap, &heap_size,
+        (HeapNode) {.exp = p->arr[0].exp + q->arr[0].exp, .i = 0, .j = 0});
+
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(1);
+    Poly zero = PolyZero();
+    Mono current = MonoFromPoly(&zero, 0);
+
+    while (heap_size > 0)
+    {
+        HeapNode node = HeapPop(heap, &heap_size);
+        if (node.j == 0 && node.i + 1 < p->size)
+        {
+            // Kolejny wiersz zaczyna sie dopiero po pobraniu poprzedniego.
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = p->arr[node.i + 1].exp + q->arr[0].exp,
+                .i = node.i + 1, .j = 0});
+        }
+        if (node.j + 1 < q->size)
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = p->arr[node.i].exp + q->arr[node.j + 1].exp,
+                .i = node.i, .j = node.j + 1});
+        }
+
+        Mono multiplied_mono = MulMonos(&(p->arr[node.i]), &(q->arr[node.j]));
+        MergeProduct(&r, &current, &multiplied_mono);
+    }
+    InsertIfNotZero(&r, &current);
+    PolyFree(heap);
+
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+Minimalna liczba par mnozonych jednomianów, od której mnozenie
+jest dzielone na zadania puli watków.
+*/
+#define PARALLEL_MUL_PAIRS 4096
+
+/**
+Liczba próbek wykladników iloczynu na jedno zadanie, uzywanych
+do wyznaczenia granic zakresów.
+*/
+#define MUL_SAMPLES_PER_TASK 16
+
+/**
+* Zadanie wyznaczajace te jednomiany iloczynu, których wykladniki
+* naleza do zakresu [lo, hi).
+*/
+typedef struct
+{
+    const Poly* p; ///< krótszy z mnozonych wielomianów
+    const Poly* q; ///< dluzszy z mnozonych wielomianów
+    long long lo; ///< poczatek zakresu wykladników
+    long long hi; ///< koniec zakresu wykladników
+    Poly* r; ///< wynik: jednomiany z zakresu, w kolejnosci rosnacych wykladników
+}   MulRangeTask;
+
+/**
+* Wykonuje zadanie MulRangeTask. Dziala jak MulTwoNotEmptyPolys,
+* ale kazdy wiersz kopca zaczyna od pierwszego iloczynu z zakresu.
+* @param[in] arg: zadanie
+*/
+static void MulRange(void* arg)
+{
+    MulRangeTask* t = arg;
+    const Poly* p = t->p;
+    const Poly* q = t->q;
+    HeapNode* heap = PolyMalloc(p->size * sizeof(HeapNode));
+    CHECK_PTR(heap);
+    size_t heap_size = 0;
+    for (size_t i = 0; i < p->size; i++)
+    {
+        size_t j = LowerBoundExp(q, t->lo - p->arr[i].exp);
+        if (j < q->size && p->arr[i].exp + q->arr[j].exp < t->hi)
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = p->arr[i].exp + q->arr[j].exp, .i = i, .j = j});
+        }
+    }
+
+    t->r->size = 0;
+    t->r->arr = MonosAlloc(1);
+    Poly zero = PolyZero();
+    Mono current = MonoFromPoly(&zero, 0);
+    while (heap_size > 0)
+    {
+        HeapNode node = HeapPop(heap, &heap_size);
+        if (node.j + 1 < q->size && p->arr[node.i].exp + q->arr[node.j + 1].exp < t->hi)
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = p->arr[node.i].exp + q->arr[node.j + 1].exp,
+                .i = node.i, .j = node.j + 1});
+        }
+        Mono multiplied_mono = MulMonos(&(p->arr[node.i]), &(q->arr[node.j]));
+        MergeProduct(t->r, &current, &multiplied_mono);
+    }
+    InsertIfNotZero(t->r, &current);
+    PolyFree(heap);
+}
+
+/**
+* Porównuje dwa wykladniki, na potrzeby qsort.
+* @param[in] a: wskaznik na wykladnik
+* @param[in] b: wskaznik na wykladnik
+* @return -1, 0 lub 1
+*/
+static int CompareExps(const void* a, const void* b)
+{
+    long long x = *(const long long*)a;
+    long long y = *(const long long*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+* Sprawdza, czy mnozenie wielomianów oplaca sie wykonac równolegle.
+* @param[in] p: wielomian niebedacy wspólczynnikiem
+* @param[in] q: wielomian niebedacy wspólczynnikiem
+* @return bool
+*/
+static bool MulIsParallel(const Poly* p, const Poly* q)
+{
+    return ParallelEnabled() && p->size * q->size >= PARALLEL_MUL_PAIRS;
+}
+
+/**
+* Mnozy dwa wielomiany, z których zaden nie jest wspólczynnikowy,
+* dzielac zakres wykladników iloczynu na rozlaczne przedzialy liczone
+* przez osobne zadania puli watków. Granice przedzialów to kwantyle
+* wykladników próbki iloczynów jednomianów. Zagniezdzone mnozenia
+* wspólczynników moga same dzielic sie dalej na zadania.
+* Wynik jest taki sam jak MulTwoNotEmptyPolys.
+* @param[in] p: wielomian
+* @param[in] q: wielomian
+* @return wielomian p*q
+*/
+static Poly MulParallel(const Poly* p, const Poly* q)
+{
+    assert(!PolyIsCoeff(p) && !PolyIsCoeff(q));
+    if (p->size > q->size)
+    {
+        const Poly* temp = p;
+        p = q;
+        q = temp;
+    }
+    size_t num_tasks = PoolThreads() * TASKS_PER_THREAD;
+    size_t num_samples = num_tasks * MUL_SAMPLES_PER_TASK;
+    long long* samples = malloc(num_samples * sizeof(long long));
+    CHECK_PTR(samples);
+    for (size_t k = 0; k < num_samples; k++)
+    {
+        uint64_t bits = MixBits(k);
+        size_t i = (bits >> 32) % p->size;
+        size_t j = (bits & UINT32_MAX) % q->size;
+        samples[k] = p->arr[i].exp + q->arr[j].exp;
+    }
+    qsort(samples, num_samples, sizeof(long long), CompareExps);
+
+    MulRangeTask* tasks = malloc(num_tasks * sizeof(MulRangeTask));
+    Poly* parts = malloc(num_tasks * sizeof(Poly));
+    CHECK_PTR(tasks);
+    CHECK_PTR(parts);
+    PoolGroup group;
+    PoolGroupInit(&group);
+    size_t used_tasks = 0;
+    // Skrajne granice sa na tyle daleko od zakresu wykladników, zeby
+    // odejmowanie od nich wykladnika jednomianu nie przepelnialo long long.
+    long long lo = LLONG_MIN / 2;
+    for (size_t k = 1; k <= num_tasks; k++)
+    {
+        long long hi = (k == num_tasks) ? LLONG_MAX / 2 : samples[k * MUL_SAMPLES_PER_TASK];
+        if (hi <= lo)
+        {
+            continue;
+        }
+        tasks[used_tasks] = (MulRangeTask) {.p = p, .q = q, .lo = lo, .hi = hi,
+            .r = &parts[used_tasks]};
+        PoolSpawn(&group, MulRange, &tasks[used_tasks]);
+        used_tasks++;
+        lo = hi;
+    }
+    PoolWait(&group);
+    free(samples);
+    free(tasks);
+
+    Poly r = ConcatParts(parts, used_tasks);
+    free(parts);
+    return r;
+}
+
+/**
+ * Ustawia liczbę wątków, na których biblioteka wykonuje równolegle
+ * kosztowne operacje. Uruchamia lub zatrzymuje pulę wątków.
+ * @param[in] threads : liczba wątków; 0 lub 1 wyłącza obliczenia równoległe
+ */
+void PolySetThreads(unsigned int threads)
+{
+    poly_threads = (threads > 1) ? threads : 0;
+    PoolStart(poly_threads);
+}
+
 /**
  * Mnoży dwa wielomiany.
  * @param[in] p : wielomian @f$p@f$
@@ -681,23 +1915,78 @@ Poly PolyMul(const Poly *p, const Poly *q)
     {
         return PolyMulWithCoeff(p, q);
     }
-    Mono* components = malloc(2*sizeof(Mono));
-    CHECK_PTR(components);
-    size_t components_size = 0;
-    // Mnozy ich jednomiany kazdy z kazdym
-    for(size_t i = 0; i < p->size; i++)
+    if (MulIsParallel(p, q))
     {
-        for(size_t j = 0; j < q->size; j++)
+        return MulParallel(p, q);
+    }
+    return MulTwoNotEmptyPolys(p, q);
+}
+
+/**
+* Mnozy w miejscu wielomian przez wspólczynnik.
+* Przyjmuje na wlasnosc zawartosc wielomianu p.
+* @param[in] p: wielomian
+* @param[in] c: wspólczynnik
+* @return wielomian p*c
+*/
+static Poly MulByCoeffOwned(Poly* p, poly_coeff_t c)
+{
+    assert(p);
+    Poly r = *p;
+    if (PolyIsCoeff(&r))
+    {
+        r.coeff *= c;
+        return r;
+    }
+    if (c == 0)
+    {
+        PolyDestroy(&r);
+        return PolyZero();
+    }
+    PolyMakeUnique(&r);
+    size_t new_size = 0;
+    for (size_t i = 0; i < r.size; i++)
+    {
+        // Usuwa jednomiany, które sie wyzerowaly, przesuwajac pozostale.
+        Poly s = MulByCoeffOwned(&(r.arr[i].p), c);
+        if (!PolyIsZero(&s))
         {
-            Mono multiplied_mono = MulMonos(&(p->arr[i]), &(q->arr[j]));
-            InsertEnd(&components, &multiplied_mono, components_size);
-            components_size++;
+            r.arr[new_size++] = MonoFromPoly(&s, r.arr[i].exp);
         }
     }
-    Poly res = PolyAddMonos(components_size, components);
-    free(components);
-    components = NULL;
-    PolyReduce(&res);
+    r.size = new_size;
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+ * Mnoży dwa wielomiany.
+ * Przejmuje na własność zawartość wielomianów @p p i @p q.
+ * Jeśli jeden z nich jest współczynnikiem, drugi jest mnożony w miejscu.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulOwned(Poly *p, Poly *q)
+{
+    assert(p && q);
+    Poly res;
+    if (PolyIsCoeff(q))
+    {
+        res = MulByCoeffOwned(p, q->coeff);
+    }
+    else if (PolyIsCoeff(p))
+    {
+        res = MulByCoeffOwned(q, p->coeff);
+    }
+    else
+    {
+        res = PolyMul(p, q);
+        PolyDestroy(p);
+        PolyDestroy(q);
+    }
+    *p = PolyZero();
+    *q = PolyZero();
     return res;
 }
 
@@ -716,6 +2005,21 @@ static poly_exp_t max_poly_exp_t(poly_exp_t a, poly_exp_t b)
     return b;
 }
 
+/**
+* Zwraca wiekszy sposród rozmiarów.
+* @param[in] a: rozmiar
+* @param[in] b: rozmiar
+* @return max(a, b)
+*/
+static size_t max_size_t(size_t a, size_t b)
+{
+    if(a > b)
+    {
+        return a;
+    }
+    return b;
+}
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -829,48 +2133,6 @@ static poly_coeff_t Power(poly_coeff_t base, poly_exp_t exp)
 
 
 
-/**
-* Oblicza jednomian bedacy wartoscia jednomianu m w x,
-* wstawia go do tablicy components.
-* @param[in] m: jednomian
-* @param[in] x: wartosc
-* @param[in] components: wskaznik do tablicy jednomianów
-* @param[in] components_size: rozmiar tablicy @f$ @components @f$
-*/
-static void ComputeComponent(const Mono *m, poly_coeff_t x,
-    Mono** components, unsigned int* components_size)
-{
-    if (PolyIsCoeff(&((*m).p)))
-    {
-        Poly multiplied_coeffs = PolyFromCoeff
-            (Power(x, (*m).exp) * (*m).p.coeff);
-
-        Mono m_temp = MonoFromPoly(&multiplied_coeffs, 0);
-        InsertEnd(components, &m_temp, *components_size);
-        (*components_size)++;
-    }
-    else
-    {
-        for (size_t j = 0; j < (*m).p.size; j++)
-        {
-            Poly power_coeff = PolyFromCoeff(Power(x, (*m).exp));
-            Poly multiplied_polys = PolyMulWithCoeff
-                (&((*m).p.arr[j].p), &power_coeff);
-
-            if (!PolyIsZero(&multiplied_polys))
-            {
-                Mono m_temp = MonoFromPoly
-                    (&multiplied_polys, (*m).p.arr[j].exp);
-
-                InsertEnd(components, &m_temp, *components_size);
-                (*components_size)++;
-            }
-            PolyDestroy(&power_coeff);
-        }
-    }
-}
-
-
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -884,46 +2146,1730 @@ static void ComputeComponent(const Mono *m, poly_coeff_t x,
  */
 Poly PolyAt(const Poly* p, poly_coeff_t x)
 {
+    /*
+    Jednomiany sa posortowane po wykladnikach, wiec kolejna potege x
+    otrzymuje z poprzedniej, podnoszac x tylko do róznicy wykladników.
+    Wspólczynniki bedace wielomianami scala za pomoca kopca,
+    jak przy mnozeniu, bez sortowania. */
     assert(p);
     if (PolyIsCoeff(p))
     {
         return PolyClone(p);
     }
-    else if (p->size == 1 && p->arr[0].exp == 0 && PolyIsCoeff(&(p->arr[0].p)))
+
+    poly_coeff_t* powers = PolyMalloc(p->size * sizeof(poly_coeff_t));
+    CHECK_PTR(powers);
+    HeapNode* heap = PolyMalloc(p->size * sizeof(HeapNode));
+    CHECK_PTR(heap);
+    size_t heap_size = 0;
+    poly_coeff_t power = 1;
+    poly_coeff_t coeffs_sum = 0;
+    poly_exp_t previous_exp = 0;
+
+    for (size_t i = 0; i < p->size && power != 0; i++)
     {
-        return PolyClone(&(p->arr[0].p));
+        // Gdy potega sie wyzeruje, kolejne tez beda zerowe.
+        power *= Power(x, p->arr[i].exp - previous_exp);
+        previous_exp = p->arr[i].exp;
+        powers[i] = power;
+        const Poly* coeff = &(p->arr[i].p);
+        if (PolyIsCoeff(coeff))
+        {
+            coeffs_sum += power * coeff->coeff;
+        }
+        else if (power != 0)
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = coeff->arr[0].exp, .i = i, .j = 0});
+        }
     }
 
-    Mono* components = malloc(sizeof(Mono));
-    CHECK_PTR(components);
-    unsigned int components_size = 0;
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(1);
+    Mono current = {.p = PolyFromCoeff(coeffs_sum), .exp = 0};
 
-    for (size_t i = 0; i < p->size; i++)
+    while (heap_size > 0)
     {
-        ComputeComponent(&(p->arr[i]), x, &components, &components_size);
+        HeapNode node = HeapPop(heap, &heap_size);
+        const Poly* coeff = &(p->arr[node.i].p);
+        if (node.j + 1 < coeff->size)
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = coeff->arr[node.j + 1].exp,
+                .i = node.i, .j = node.j + 1});
+        }
+
+        Poly power_coeff = PolyFromCoeff(powers[node.i]);
+        Poly multiplied = PolyMulWithCoeff(&(coeff->arr[node.j].p), &power_coeff);
+        if (node.exp == current.exp)
+        {
+            current.p = PolyAddOwned(&current.p, &multiplied);
+        }
+        else
+        {
+            InsertIfNotZero(&r, &current);
+            current = (Mono) {.p = multiplied, .exp = node.exp};
+        }
     }
+    InsertIfNotZero(&r, &current);
+    PolyFree(heap);
+    PolyFree(powers);
+
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+Liczba punktów przetwarzanych razem w petlach przebiegajacych po punktach.
+*/
+#define EVAL_BLOCK 64
+
+/**
+Czy petle po punktach maja wersje dla procesorów z AVX2 wybierana
+w czasie dzialania programu. Wymaga kompilatora zgodnego z GCC i x86.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EVAL_AVX2 1
+#else
+#define EVAL_AVX2 0
+#endif
 
-    if (components_size == 0)
+/**
+Wymusza wkompilowanie tresci petli po punktach w kazda wersje jader,
+zeby kompilowala sie ona z atrybutami tej wersji.
+*/
+#if EVAL_AVX2
+#define EVAL_INLINE __attribute__((always_inline)) inline
+#else
+#define EVAL_INLINE inline
+#endif
+
+/**
+* Mnozy kazdy z len elementów tablicy acc przez odpowiadajaca mu wartosc
+* z tablicy xs podniesiona do potegi exp, szybkim potegowaniem
+* wykonywanym dla wszystkich punktów naraz.
+* @param[in] acc: tablica mnozonych wartosci
+* @param[in] xs: tablica podstaw poteg
+* @param[in] len: liczba punktów, co najwyzej EVAL_BLOCK
+* @param[in] exp: wykladnik
+*/
+static EVAL_INLINE void MulByPowersBody(poly_coeff_t* restrict acc,
+    const poly_coeff_t* restrict xs, size_t len, poly_exp_t exp)
+{
+    poly_coeff_t base[EVAL_BLOCK];
+    for (size_t k = 0; k < len; k++)
     {
-        FreeArrOfMonos(&components, components_size);
-        return PolyZero();
+        base[k] = xs[k];
     }
-
-    Poly res;
-    if (components_size == 1 && components[0].exp == 0 &&
-        PolyIsCoeff(&(components[0].p)))
+    for (poly_exp_t e = exp; e > 0; e /= 2)
     {
-        res = PolyFromCoeff(components[0].p.coeff);
-        FreeArrOfMonos(&components, components_size);
+        if (e % 2 == 1)
+        {
+            for (size_t k = 0; k < len; k++)
+            {
+                acc[k] *= base[k];
+            }
+        }
+        if (e > 1)
+        {
+            for (size_t k = 0; k < len; k++)
+            {
+                base[k] *= base[k];
+            }
+        }
     }
-    else
+}
+
+/**
+* Dodaje do kazdego z len elementów tablicy out odpowiadajacy mu element in.
+* @param[in,out] out: tablica wyników
+* @param[in] in: tablica dodawanych wartosci
+* @param[in] len: liczba punktów
+*/
+static EVAL_INLINE void AddBody(poly_coeff_t* restrict out,
+    const poly_coeff_t* restrict in, size_t len)
+{
+    for (size_t k = 0; k < len; k++)
     {
-        res = PolyAddMonos(components_size, components);
-        free(components);
-        components = NULL;
+        out[k] += in[k];
     }
+}
 
-    PolyReduce(&res);
-    return res;
+/**
+* Wersja MulByPowersBody dla dowolnego procesora.
+* @param[in] acc: tablica mnozonych wartosci
+* @param[in] xs: tablica podstaw poteg
+* @param[in] len: liczba punktów
+* @param[in] exp: wykladnik
+*/
+static void MulByPowersScalar(poly_coeff_t* restrict acc,
+    const poly_coeff_t* restrict xs, size_t len, poly_exp_t exp)
+{
+    MulByPowersBody(acc, xs, len, exp);
 }
 
+/**
+* Wersja AddBody dla dowolnego procesora.
+* @param[in,out] out: tablica wyników
+* @param[in] in: tablica dodawanych wartosci
+* @param[in] len: liczba punktów
+*/
+static void AddScalar(poly_coeff_t* restrict out, const poly_coeff_t* restrict in, size_t len)
+{
+    AddBody(out, in, len);
+}
+
+#if EVAL_AVX2
+/**
+* Wersja MulByPowersBody skompilowana dla AVX2: kompilator mnozy
+* cztery 64-bitowe wartosci naraz w rejestrach ymm.
+* @param[in] acc: tablica mnozonych wartosci
+* @param[in] xs: tablica podstaw poteg
+* @param[in] len: liczba punktów
+* @param[in] exp: wykladnik
+*/
+__attribute__((target("avx2")))
+static void MulByPowersAvx2(poly_coeff_t* restrict acc,
+    const poly_coeff_t* restrict xs, size_t len, poly_exp_t exp)
+{
+    MulByPowersBody(acc, xs, len, exp);
+}
+
+/**
+* Wersja AddBody skompilowana dla AVX2.
+* @param[in,out] out: tablica wyników
+* @param[in] in: tablica dodawanych wartosci
+* @param[in] len: liczba punktów
+*/
+__attribute__((target("avx2")))
+static void AddAvx2(poly_coeff_t* restrict out, const poly_coeff_t* restrict in, size_t len)
+{
+    AddBody(out, in, len);
+}
+#endif
+
+/**
+* Jadra petli po punktach bloku, wybrane dla biezacego procesora.
+*/
+typedef struct
+{
+    /// mnozy wartosci przez potegi argumentów
+    void (*mul_by_powers)(poly_coeff_t* restrict, const poly_coeff_t* restrict, size_t, poly_exp_t);
+    /// dodaje wartosci
+    void (*add)(poly_coeff_t* restrict, const poly_coeff_t* restrict, size_t);
+}   EvalKernels;
+
+/**
+* Wybiera jadra petli po punktach: wersje AVX2, jesli procesor ja obsluguje,
+* wpp. wersje dla dowolnego procesora.
+* @return jadra
+*/
+static const EvalKernels* EvalKernelsSelect(void)
+{
+    static const EvalKernels scalar = {MulByPowersScalar, AddScalar};
+#if EVAL_AVX2
+    static const EvalKernels avx2 = {MulByPowersAvx2, AddAvx2};
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return &avx2;
+    }
+#endif
+    return &scalar;
+}
+
+/**
+* Mnozy kazdy element tablicy acc przez odpowiadajaca mu wartosc
+* z tablicy xs podniesiona do potegi exp, blokami po EVAL_BLOCK punktów.
+* @param[in] kernels: jadra petli po punktach
+* @param[in] acc: tablica mnozonych wartosci
+* @param[in] xs: tablica podstaw poteg
+* @param[in] n: rozmiar tablic
+* @param[in] exp: wykladnik
+*/
+static void MulByPowers(const EvalKernels* kernels, poly_coeff_t* restrict acc,
+    const poly_coeff_t* restrict xs, size_t n, poly_exp_t exp)
+{
+    assert(exp >= 0);
+    for (size_t beg = 0; beg < n && exp > 0; beg += EVAL_BLOCK)
+    {
+        size_t len = n - beg < EVAL_BLOCK ? n - beg : EVAL_BLOCK;
+        kernels->mul_by_powers(acc + beg, xs + beg, len, exp);
+    }
+}
+
+/**
+ * Wylicza wartości wielomianu w wielu punktach naraz.
+ * Dla każdego @f$k@f$ wstawia do @p out[k] wielomian PolyAt(p, xs[k]).
+ * Potęgi argumentów są liczone dla wszystkich punktów jednocześnie,
+ * a jednomiany wyników są scalane jednym przejściem po wielomianie @p p.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] xs : tablica argumentów
+ * @param[in] n : liczba argumentów
+ * @param[out] out : tablica wyników
+ */
+void PolyAtMany(const Poly* p, const poly_coeff_t xs[], size_t n, Poly out[])
+{
+    assert(p && (n == 0 || (xs && out)));
+    if (PolyIsCoeff(p) || n == 0)
+    {
+        for (size_t k = 0; k < n; k++)
+        {
+            out[k] = PolyClone(p);
+        }
+        return;
+    }
+
+    // Wiersz i tablicy powers zawiera potegi x^exp dla i-tego jednomianu.
+    poly_coeff_t* powers = PolyMalloc(p->size * n * sizeof(poly_coeff_t));
+    CHECK_PTR(powers);
+    Mono* current = PolyMalloc(n * sizeof(Mono));
+    CHECK_PTR(current);
+    HeapNode* heap = PolyMalloc(p->size * sizeof(HeapNode));
+    CHECK_PTR(heap);
+    size_t heap_size = 0;
+    const EvalKernels* kernels = EvalKernelsSelect();
+
+    for (size_t k = 0; k < n; k++)
+    {
+        powers[k] = 1;
+        current[k] = (Mono) {.p = PolyZero(), .exp = 0};
+        out[k].size = 0;
+        out[k].arr = MonosAlloc(1);
+    }
+    for (size_t i = 0; i < p->size; i++)
+    {
+        poly_coeff_t* row = &powers[i * n];
+        if (i > 0)
+        {
+            memcpy(row, row - n, n * sizeof(poly_coeff_t));
+        }
+        poly_exp_t previous_exp = i > 0 ? p->arr[i - 1].exp : 0;
+        MulByPowers(kernels, row, xs, n, p->arr[i].exp - previous_exp);
+
+        const Poly* coeff = &(p->arr[i].p);
+        if (PolyIsCoeff(coeff))
+        {
+            for (size_t k = 0; k < n; k++)
+            {
+                current[k].p.coeff += row[k] * coeff->coeff;
+            }
+        }
+        else
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = coeff->arr[0].exp, .i = i, .j = 0});
+        }
+    }
+
+    poly_exp_t current_exp = 0;
+    while (heap_size > 0)
+    {
+        HeapNode node = HeapPop(heap, &heap_size);
+        const Poly* coeff = &(p->arr[node.i].p);
+        if (node.j + 1 < coeff->size)
+        {
+            HeapPush(heap, &heap_size, (HeapNode) {
+                .exp = coeff->arr[node.j + 1].exp,
+                .i = node.i, .j = node.j + 1});
+        }
+        for (size_t k = 0; k < n; k++)
+        {
+            Poly power_coeff = PolyFromCoeff(powers[node.i * n + k]);
+            Poly multiplied = PolyMulWithCoeff(&(coeff->arr[node.j].p), &power_coeff);
+            if (node.exp == current_exp)
+            {
+                current[k].p = PolyAddOwned(&current[k].p, &multiplied);
+            }
+            else
+            {
+                InsertIfNotZero(&out[k], &current[k]);
+                current[k] = (Mono) {.p = multiplied, .exp = node.exp};
+            }
+        }
+        current_exp = node.exp;
+    }
+    for (size_t k = 0; k < n; k++)
+    {
+        InsertIfNotZero(&out[k], &current[k]);
+        PolyReduce(&out[k]);
+    }
+    PolyFree(heap);
+    PolyFree(current);
+    PolyFree(powers);
+}
+
+/**
+* Wylicza wartosci liczbowe wielomianu dla bloku co najwyzej EVAL_BLOCK punktów
+* schematem Hornera, wykonujac kazdy krok dla wszystkich punktów naraz.
+* Wartosc zmiennej o indeksie v w k-tym punkcie to xs[v * stride + k].
+* Zmienne o indeksach nie mniejszych niz num_vars maja wartosc 0.
+* @param[in] kernels: jadra petli po punktach
+* @param[in] p: wielomian
+* @param[in] xs: wartosci zmiennych
+* @param[in] stride: odleglosc miedzy wartosciami kolejnych zmiennych w xs
+* @param[in] num_vars: liczba zmiennych, których wartosci sa w xs
+* @param[in] len: liczba punktów
+* @param[out] out: tablica wyników
+*/
+static void EvalBlock(const EvalKernels* kernels, const Poly* p, const poly_coeff_t* xs,
+    size_t stride, size_t num_vars, size_t len, poly_coeff_t* restrict out)
+{
+    assert(len <= EVAL_BLOCK);
+    if (PolyIsCoeff(p))
+    {
+        for (size_t k = 0; k < len; k++)
+        {
+            out[k] = p->coeff;
+        }
+        return;
+    }
+    if (num_vars == 0)
+    {
+        // Zmienna ma wartosc 0, wiec zostaje tylko jednomian o wykladniku 0.
+        if (p->arr[0].exp == 0)
+        {
+            EvalBlock(kernels, &(p->arr[0].p), xs, stride, 0, len, out);
+        }
+        else
+        {
+            memset(out, 0, len * sizeof(poly_coeff_t));
+        }
+        return;
+    }
+
+    poly_coeff_t child[EVAL_BLOCK];
+    size_t i = p->size - 1;
+    EvalBlock(kernels, &(p->arr[i].p), xs + stride, stride, num_vars - 1, len, out);
+    while (i > 0)
+    {
+        kernels->mul_by_powers(out, xs, len, p->arr[i].exp - p->arr[i - 1].exp);
+        i--;
+        const Poly* coeff = &(p->arr[i].p);
+        if (PolyIsCoeff(coeff))
+        {
+            for (size_t k = 0; k < len; k++)
+            {
+                out[k] += coeff->coeff;
+            }
+        }
+        else
+        {
+            EvalBlock(kernels, coeff, xs + stride, stride, num_vars - 1, len, child);
+            kernels->add(out, child, len);
+        }
+    }
+    kernels->mul_by_powers(out, xs, len, p->arr[0].exp);
+}
+
+/**
+ * Wylicza wartości liczbowe wielomianu w wielu punktach naraz,
+ * wstawiając wartości pod wszystkie zmienne.
+ * Wartość zmiennej @f$x_v@f$ w @f$k@f$-tym punkcie to `xs[v * n + k]`.
+ * Zmienne o indeksach nie mniejszych niż @p num_vars mają wartość 0.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] num_vars : liczba zmiennych, których wartości są w @p xs
+ * @param[in] n : liczba punktów
+ * @param[in] xs : wartości zmiennych
+ * @param[out] out : tablica @p n wyników
+ */
+void PolyEvalBatch(const Poly* p, size_t num_vars, size_t n,
+    const poly_coeff_t xs[], poly_coeff_t out[])
+{
+    assert(p && (n == 0 || out) && (n == 0 || num_vars == 0 || xs));
+    const EvalKernels* kernels = EvalKernelsSelect();
+    for (size_t beg = 0; beg < n; beg += EVAL_BLOCK)
+    {
+        size_t len = n - beg < EVAL_BLOCK ? n - beg : EVAL_BLOCK;
+        EvalBlock(kernels, p, xs + beg, n, num_vars, len, out + beg);
+    }
+}
+
+/**
+* Typ rozkazu programu obliczajacego wartosc wielomianu.
+*/
+typedef enum
+{
+    OP_PUSH, ///< wklada na stos stala
+    OP_ADD_CONST, ///< dodaje stala do wierzcholka stosu
+    OP_MUL_POW, ///< mnozy wierzcholek stosu przez potege zmiennej z tablicy poteg
+    OP_ADD_TOP ///< zdejmuje wierzcholek stosu i dodaje go do nowego wierzcholka
+}   ProgramOp;
+
+/**
+* Potega zmiennej, przez która mnoza rozkazy OP_MUL_POW.
+*/
+typedef struct
+{
+    size_t var; ///< indeks zmiennej
+    poly_exp_t exp; ///< wykladnik, czyli róznica wykladników sasiednich jednomianów
+}   ProgramPower;
+
+/**
+* Rozkaz programu obliczajacego wartosc wielomianu.
+*/
+typedef struct
+{
+    ProgramOp op; ///< typ rozkazu
+    union
+    {
+        poly_coeff_t coeff; ///< stala dla OP_PUSH i OP_ADD_CONST
+        size_t power; ///< indeks potegi w tablicy poteg dla OP_MUL_POW
+        ProgramPower* pending; ///< potega dla OP_MUL_POW w trakcie kompilacji
+    };
+}   Instruction;
+
+/**
+* Program obliczajacy wartosc wielomianu - plaska tablica rozkazów
+* i tablica róznych poteg zmiennych, przez które mnoza te rozkazy.
+*/
+struct PolyProgram
+{
+    Instruction* code; ///< tablica rozkazów
+    size_t size; ///< liczba rozkazów
+    ProgramPower* powers; ///< rózne potegi zmiennych, posortowane
+    size_t num_powers; ///< liczba poteg
+    size_t max_depth; ///< maksymalna glebokosc stosu wartosci
+};
+
+/**
+* Liczy rozkazy potrzebne do obliczenia wartosci wielomianu
+* oraz glebokosc stosu wartosci.
+* @param[in] p: wielomian
+* @param[out] depth: glebokosc stosu potrzebna do obliczenia wartosci p
+* @return liczba rozkazów
+*/
+static size_t CountInstructions(const Poly* p, size_t* depth)
+{
+    *depth = 1;
+    if (PolyIsCoeff(p))
+    {
+        return 1;
+    }
+    size_t child_depth;
+    size_t count = CountInstructions(&(p->arr[p->size - 1].p), &child_depth);
+    *depth = child_depth;
+    for (size_t i = p->size - 1; i > 0; i--)
+    {
+        count++;
+        if (PolyIsCoeff(&(p->arr[i - 1].p)))
+        {
+            count++;
+        }
+        else
+        {
+            count += CountInstructions(&(p->arr[i - 1].p), &child_depth) + 1;
+            if (child_depth + 1 > *depth)
+            {
+                *depth = child_depth + 1;
+            }
+        }
+    }
+    return count + (p->arr[0].exp > 0);
+}
+
+/**
+* Dopisuje do programu rozkaz mnozacy wierzcholek stosu przez potege zmiennej,
+* a sama potege do tablicy poteg. Indeks potegi jest ustalany dopiero
+* po usunieciu z tablicy powtórzen.
+* @param[in] var: indeks zmiennej
+* @param[in] exp: wykladnik
+* @param[in] code: tablica rozkazów
+* @param[in] size: wskaznik na liczbe rozkazów w tablicy
+* @param[in] powers: tablica poteg
+* @param[in] num_powers: wskaznik na liczbe poteg w tablicy
+*/
+static void EmitMulPow(size_t var, poly_exp_t exp, Instruction* code, size_t* size,
+    ProgramPower* powers, size_t* num_powers)
+{
+    powers[*num_powers] = (ProgramPower) {.var = var, .exp = exp};
+    code[(*size)++] = (Instruction) {.op = OP_MUL_POW, .pending = &powers[(*num_powers)++]};
+}
+
+/**
+* Dopisuje do programu rozkazy obliczajace wartosc wielomianu schematem Hornera
+* i zostawiajace ja na wierzcholku stosu.
+* @param[in] p: wielomian
+* @param[in] var: indeks zmiennej glównej wielomianu
+* @param[in] code: tablica rozkazów
+* @param[in] size: wskaznik na liczbe rozkazów w tablicy
+* @param[in] powers: tablica poteg
+* @param[in] num_powers: wskaznik na liczbe poteg w tablicy
+*/
+static void EmitInstructions(const Poly* p, size_t var, Instruction* code, size_t* size,
+    ProgramPower* powers, size_t* num_powers)
+{
+    if (PolyIsCoeff(p))
+    {
+        code[(*size)++] = (Instruction) {.op = OP_PUSH, .coeff = p->coeff};
+        return;
+    }
+    EmitInstructions(&(p->arr[p->size - 1].p), var + 1, code, size, powers, num_powers);
+    for (size_t i = p->size - 1; i > 0; i--)
+    {
+        EmitMulPow(var, p->arr[i].exp - p->arr[i - 1].exp, code, size, powers, num_powers);
+        const Poly* coeff = &(p->arr[i - 1].p);
+        if (PolyIsCoeff(coeff))
+        {
+            code[(*size)++] = (Instruction) {.op = OP_ADD_CONST, .coeff = coeff->coeff};
+        }
+        else
+        {
+            EmitInstructions(coeff, var + 1, code, size, powers, num_powers);
+            code[(*size)++] = (Instruction) {.op = OP_ADD_TOP};
+        }
+    }
+    if (p->arr[0].exp > 0)
+    {
+        EmitMulPow(var, p->arr[0].exp, code, size, powers, num_powers);
+    }
+}
+
+/**
+* Porównuje potegi zmiennych najpierw po indeksie zmiennej, potem po wykladniku,
+* na potrzeby qsort i bsearch.
+* @param[in] a: wskaznik na potege
+* @param[in] b: wskaznik na potege
+* @return -1, 0 lub 1
+*/
+static int ComparePowers(const void* a, const void* b)
+{
+    const ProgramPower* x = a;
+    const ProgramPower* y = b;
+    if (x->var != y->var)
+    {
+        return x->var < y->var ? -1 : 1;
+    }
+    return (x->exp > y->exp) - (x->exp < y->exp);
+}
+
+/**
+ * Kompiluje wielomian do płaskiego programu obliczającego jego wartość.
+ * Każda różna para zmiennej i różnicy wykładników dostaje jedno miejsce
+ * w tablicy potęg, więc potęgi są liczone raz na wywołanie PolyProgramEval.
+ * @param[in] p : wielomian
+ * @return program
+ */
+PolyProgram* PolyCompile(const Poly* p)
+{
+    assert(p);
+    PolyProgram* prog = malloc(sizeof(PolyProgram));
+    CHECK_PTR(prog);
+    prog->size = CountInstructions(p, &prog->max_depth);
+    prog->code = malloc(prog->size * sizeof(Instruction));
+    CHECK_PTR(prog->code);
+    ProgramPower* pending = malloc(prog->size * sizeof(ProgramPower));
+    CHECK_PTR(pending);
+    size_t size = 0, num_pending = 0;
+    EmitInstructions(p, 0, prog->code, &size, pending, &num_pending);
+    assert(size == prog->size);
+
+    prog->powers = malloc((num_pending > 0 ? num_pending : 1) * sizeof(ProgramPower));
+    CHECK_PTR(prog->powers);
+    memcpy(prog->powers, pending, num_pending * sizeof(ProgramPower));
+    qsort(prog->powers, num_pending, sizeof(ProgramPower), ComparePowers);
+    prog->num_powers = 0;
+    for (size_t i = 0; i < num_pending; i++)
+    {
+        if (prog->num_powers == 0
+            || ComparePowers(&prog->powers[prog->num_powers - 1], &prog->powers[i]) != 0)
+        {
+            prog->powers[prog->num_powers++] = prog->powers[i];
+        }
+    }
+    for (size_t i = 0; i < prog->size; i++)
+    {
+        Instruction* ins = &prog->code[i];
+        if (ins->op == OP_MUL_POW)
+        {
+            ProgramPower* found = bsearch(ins->pending, prog->powers, prog->num_powers,
+                sizeof(ProgramPower), ComparePowers);
+            assert(found);
+            ins->power = found - prog->powers;
+        }
+    }
+    free(pending);
+    return prog;
+}
+
+/**
+ * Usuwa program z pamięci.
+ * @param[in] prog : program
+ */
+void PolyProgramDestroy(PolyProgram* prog)
+{
+    if (prog != NULL)
+    {
+        free(prog->code);
+        free(prog->powers);
+        free(prog);
+    }
+}
+
+/**
+ * Zwraca rozmiar bufora roboczego potrzebnego funkcji PolyProgramEval:
+ * tablicy potęg zmiennych i stosu wartości.
+ * @param[in] prog : program
+ * @return liczba elementów typu poly_coeff_t
+ */
+size_t PolyProgramScratchSize(const PolyProgram* prog)
+{
+    assert(prog);
+    return prog->num_powers + prog->max_depth;
+}
+
+/**
+ * Wylicza wartość liczbową skompilowanego wielomianu,
+ * wstawiając wartości pod wszystkie zmienne.
+ * Najpierw liczy każdą potrzebną potęgę zmiennej raz, a potem wykonuje
+ * rozkazy, które tylko mnożą przez te potęgi. Nie alokuje pamięci.
+ * @param[in] prog : program
+ * @param[in] xs : wartości zmiennych
+ * @param[in] num_vars : liczba zmiennych, których wartości są w @p xs
+ * @param[in] scratch : bufor roboczy o rozmiarze PolyProgramScratchSize(prog)
+ * @return wartość wielomianu
+ */
+poly_coeff_t PolyProgramEval(const PolyProgram* prog, const poly_coeff_t xs[],
+    size_t num_vars, poly_coeff_t scratch[])
+{
+    assert(prog && (num_vars == 0 || xs) && scratch);
+    poly_coeff_t* powers = scratch;
+    poly_coeff_t* stack = scratch + prog->num_powers;
+    for (size_t i = 0; i < prog->num_powers; i++)
+    {
+        const ProgramPower* pw = &prog->powers[i];
+        powers[i] = pw->var < num_vars ? Power(xs[pw->var], pw->exp) : 0;
+    }
+
+    stack[0] = 0;
+    size_t top = 0;
+    for (const Instruction* ins = prog->code; ins < prog->code + prog->size; ins++)
+    {
+        switch (ins->op)
+        {
+            case OP_PUSH:
+                stack[top++] = ins->coeff;
+                break;
+            case OP_ADD_CONST:
+                stack[top - 1] += ins->coeff;
+                break;
+            case OP_MUL_POW:
+                stack[top - 1] *= powers[ins->power];
+                break;
+            case OP_ADD_TOP:
+                top--;
+                stack[top - 1] += stack[top];
+                break;
+        }
+    }
+    return stack[0];
+}
+
+/**
+* Zwraca wykladnik zmiennej o indeksie var w danym wierszu wielomianu
+* w postaci plaskiej (0 dla zmiennych spoza wektora wykladników).
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] row: numer wiersza
+* @param[in] var: indeks zmiennej
+* @return wykladnik
+*/
+static poly_exp_t FlatExp(const PolyFlat* f, size_t row, size_t var)
+{
+    return var < f->num_vars ? f->exps[row * f->num_vars + var] : 0;
+}
+
+/**
+* Porównuje leksykograficznie wektory wykladników dwóch wierszy.
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] i: numer wiersza w f
+* @param[in] g: wielomian w postaci plaskiej
+* @param[in] j: numer wiersza w g
+* @return -1, 0 lub 1
+*/
+static int CompareFlatRows(const PolyFlat* f, size_t i, const PolyFlat* g, size_t j)
+{
+    size_t num_vars = max_size_t(f->num_vars, g->num_vars);
+    for (size_t v = 0; v < num_vars; v++)
+    {
+        poly_exp_t a = FlatExp(f, i, v), b = FlatExp(g, j, v);
+        if (a != b)
+        {
+            return a < b ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+* Tworzy pusty wielomian w postaci plaskiej z miejscem na capacity wierszy.
+* @param[in] num_vars: dlugosc wektorów wykladników
+* @param[in] capacity: liczba wierszy, na które alokuje miejsce
+* @return wielomian zerowy
+*/
+static PolyFlat FlatWithCapacity(size_t num_vars, size_t capacity)
+{
+    PolyFlat f;
+    f.size = 0;
+    f.num_vars = num_vars;
+    f.exps = malloc((capacity * num_vars + 1) * sizeof(poly_exp_t));
+    CHECK_PTR(f.exps);
+    f.coeffs = malloc((capacity + 1) * sizeof(poly_coeff_t));
+    CHECK_PTR(f.coeffs);
+    return f;
+}
+
+/**
+* Zapewnia miejsce na kolejny wiersz, w razie potrzeby podwajajac tablice.
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] capacity: wskaznik na liczbe wierszy, na które jest miejsce
+*/
+static void FlatReserve(PolyFlat* f, size_t* capacity)
+{
+    if (f->size < *capacity)
+    {
+        return;
+    }
+    *capacity = 2 * (*capacity) + 1;
+    f->exps = realloc(f->exps, (*capacity * f->num_vars + 1) * sizeof(poly_exp_t));
+    CHECK_PTR(f->exps);
+    f->coeffs = realloc(f->coeffs, (*capacity + 1) * sizeof(poly_coeff_t));
+    CHECK_PTR(f->coeffs);
+}
+
+/**
+* Zwraca glebokosc zagniezdzenia wielomianu, czyli liczbe jego zmiennych.
+* @param[in] p: wielomian
+* @return glebokosc wielomianu
+*/
+static size_t PolyDepth(const Poly* p)
+{
+    if (PolyIsCoeff(p))
+    {
+        return 0;
+    }
+    size_t depth = 0;
+    for (size_t i = 0; i < p->size; i++)
+    {
+        depth = max_size_t(depth, PolyDepth(&(p->arr[i].p)));
+    }
+    return depth + 1;
+}
+
+/**
+* Liczy niezerowe wspólczynniki liczbowe wielomianu.
+* @param[in] p: wielomian
+* @return liczba wyrazów wielomianu
+*/
+static size_t PolyCountTerms(const Poly* p)
+{
+    if (PolyIsCoeff(p))
+    {
+        return p->coeff != 0;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < p->size; i++)
+    {
+        count += PolyCountTerms(&(p->arr[i].p));
+    }
+    return count;
+}
+
+/**
+* Dopisuje wyrazy wielomianu do postaci plaskiej w kolejnosci preorder,
+* która jest zgodna z porzadkiem leksykograficznym wykladników.
+* @param[in] p: wielomian
+* @param[in] var: indeks zmiennej glównej wielomianu
+* @param[in] path: wykladniki zmiennych o indeksach mniejszych niz var
+* @param[in] f: wielomian w postaci plaskiej
+*/
+static void FlatFill(const Poly* p, size_t var, poly_exp_t* path, PolyFlat* f)
+{
+    if (PolyIsCoeff(p))
+    {
+        if (p->coeff != 0)
+        {
+            poly_exp_t* row = &(f->exps[f->size * f->num_vars]);
+            memcpy(row, path, var * sizeof(poly_exp_t));
+            memset(row + var, 0, (f->num_vars - var) * sizeof(poly_exp_t));
+            f->coeffs[f->size++] = p->coeff;
+        }
+        return;
+    }
+    for (size_t i = 0; i < p->size; i++)
+    {
+        path[var] = p->arr[i].exp;
+        FlatFill(&(p->arr[i].p), var + 1, path, f);
+    }
+}
+
+/**
+ * Zamienia wielomian na postać płaską.
+ * @param[in] p : wielomian
+ * @return wielomian w postaci płaskiej
+ */
+PolyFlat PolyToFlat(const Poly* p)
+{
+    assert(p);
+    PolyFlat f = FlatWithCapacity(PolyDepth(p), PolyCountTerms(p));
+    poly_exp_t* path = malloc((f.num_vars + 1) * sizeof(poly_exp_t));
+    CHECK_PTR(path);
+    FlatFill(p, 0, path, &f);
+    free(path);
+    return f;
+}
+
+/**
+* Buduje wielomian z wierszy postaci plaskiej o numerach z przedzialu
+* [beg, end), które maja równe wykladniki zmiennych o indeksach mniejszych
+* niz var.
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] beg: pierwszy wiersz
+* @param[in] end: wiersz za ostatnim
+* @param[in] var: indeks zmiennej glównej budowanego wielomianu
+* @return wielomian
+*/
+static Poly FlatRangeToPoly(const PolyFlat* f, size_t beg, size_t end, size_t var)
+{
+    if (beg == end)
+    {
+        return PolyZero();
+    }
+    bool only_coeff = (end - beg == 1);
+    for (size_t v = var; v < f->num_vars && only_coeff; v++)
+    {
+        only_coeff = (FlatExp(f, beg, v) == 0);
+    }
+    if (only_coeff)
+    {
+        return PolyFromCoeff(f->coeffs[beg]);
+    }
+
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(1);
+    while (beg < end)
+    {
+        size_t group_end = beg + 1;
+        while (group_end < end && FlatExp(f, group_end, var) == FlatExp(f, beg, var))
+        {
+            group_end++;
+        }
+        Mono m = {.p = FlatRangeToPoly(f, beg, group_end, var + 1),
+            .exp = FlatExp(f, beg, var)};
+        InsertEnd(&r.arr, &m, r.size);
+        r.size++;
+        beg = group_end;
+    }
+    PolyReduce(&r);
+    return r;
+}
+
+/**
+ * Zamienia wielomian w postaci płaskiej na wielomian.
+ * @param[in] f : wielomian w postaci płaskiej
+ * @return wielomian
+ */
+Poly PolyFromFlat(const PolyFlat* f)
+{
+    assert(f);
+    return FlatRangeToPoly(f, 0, f->size, 0);
+}
+
+/**
+ * Usuwa wielomian w postaci płaskiej z pamięci.
+ * @param[in] f : wielomian w postaci płaskiej
+ */
+void PolyFlatDestroy(PolyFlat* f)
+{
+    assert(f);
+    free(f->exps);
+    free(f->coeffs);
+    f->exps = NULL;
+    f->coeffs = NULL;
+    f->size = 0;
+}
+
+/**
+* Dopisuje na koniec postaci plaskiej wiersz z innego wielomianu.
+* @param[in] r: wielomian w postaci plaskiej, do którego dopisuje
+* @param[in] f: wielomian w postaci plaskiej, z którego kopiuje wiersz
+* @param[in] row: numer kopiowanego wiersza
+* @param[in] coeff: wspólczynnik dopisywanego wiersza
+*/
+static void FlatAppendRow(PolyFlat* r, const PolyFlat* f, size_t row, poly_coeff_t coeff)
+{
+    for (size_t v = 0; v < r->num_vars; v++)
+    {
+        r->exps[r->size * r->num_vars + v] = FlatExp(f, row, v);
+    }
+    r->coeffs[r->size++] = coeff;
+}
+
+/**
+ * Dodaje dwa wielomiany w postaci płaskiej, scalając ich wiersze.
+ * @param[in] f : wielomian @f$f@f$
+ * @param[in] g : wielomian @f$g@f$
+ * @return @f$f + g@f$
+ */
+PolyFlat PolyFlatAdd(const PolyFlat* f, const PolyFlat* g)
+{
+    assert(f && g);
+    PolyFlat r = FlatWithCapacity(max_size_t(f->num_vars, g->num_vars),
+        f->size + g->size);
+    size_t i = 0, j = 0;
+    while (i < f->size || j < g->size)
+    {
+        int cmp = (i >= f->size) ? 1 : (j >= g->size) ? -1 :
+            CompareFlatRows(f, i, g, j);
+        if (cmp < 0)
+        {
+            FlatAppendRow(&r, f, i, f->coeffs[i]);
+            i++;
+        }
+        else if (cmp > 0)
+        {
+            FlatAppendRow(&r, g, j, g->coeffs[j]);
+            j++;
+        }
+        else
+        {
+            poly_coeff_t sum = f->coeffs[i] + g->coeffs[j];
+            if (sum != 0)
+            {
+                FlatAppendRow(&r, f, i, sum);
+            }
+            i++;
+            j++;
+        }
+    }
+    return r;
+}
+
+/**
+* Porównuje leksykograficznie sumy wektorów wykladników wierszy
+* f[i1] + g[j1] oraz f[i2] + g[j2].
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] g: wielomian w postaci plaskiej
+* @param[in] a: pierwsza para numerów wierszy
+* @param[in] b: druga para numerów wierszy
+* @return -1, 0 lub 1
+*/
+static int CompareFlatProducts(const PolyFlat* f, const PolyFlat* g,
+    const HeapNode* a, const HeapNode* b)
+{
+    size_t num_vars = max_size_t(f->num_vars, g->num_vars);
+    for (size_t v = 0; v < num_vars; v++)
+    {
+        poly_exp_t x = FlatExp(f, a->i, v) + FlatExp(g, a->j, v);
+        poly_exp_t y = FlatExp(f, b->i, v) + FlatExp(g, b->j, v);
+        if (x != y)
+        {
+            return x < y ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+* Wstawia pare wierszy do kopca iloczynów postaci plaskich.
+* @param[in] heap: tablica bedaca kopcem
+* @param[in] heap_size: wskaznik na liczbe elementów kopca
+* @param[in] node: wstawiany element
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] g: wielomian w postaci plaskiej
+*/
+static void FlatHeapPush(HeapNode* heap, size_t* heap_size, HeapNode node,
+    const PolyFlat* f, const PolyFlat* g)
+{
+    size_t k = (*heap_size)++;
+    while (k > 0 && CompareFlatProducts(f, g, &heap[(k - 1) / 2], &node) > 0)
+    {
+        heap[k] = heap[(k - 1) / 2];
+        k = (k - 1) / 2;
+    }
+    heap[k] = node;
+}
+
+/**
+* Usuwa z kopca iloczynów postaci plaskich najmniejsza pare wierszy.
+* @param[in] heap: niepusta tablica bedaca kopcem
+* @param[in] heap_size: wskaznik na liczbe elementów kopca
+* @param[in] f: wielomian w postaci plaskiej
+* @param[in] g: wielomian w postaci plaskiej
+* @return usuniety element
+*/
+static HeapNode FlatHeapPop(HeapNode* heap, size_t* heap_size,
+    const PolyFlat* f, const PolyFlat* g)
+{
+    assert(*heap_size > 0);
+    HeapNode res = heap[0];
+    HeapNode last = heap[--(*heap_size)];
+    size_t k = 0;
+    while (2 * k + 1 < *heap_size)
+    {
+        size_t child = 2 * k + 1;
+        if (child + 1 < *heap_size &&
+            CompareFlatProducts(f, g, &heap[child + 1], &heap[child]) < 0)
+        {
+            child++;
+        }
+        if (CompareFlatProducts(f, g, &heap[child], &last) >= 0)
+        {
+            break;
+        }
+        heap[k] = heap[child];
+        k = child;
+    }
+    heap[k] = last;
+    return res;
+}
+
+/**
+ * Mnoży dwa wielomiany w postaci płaskiej.
+ * Iloczyny wierszy są wyznaczane w kolejności leksykograficznej za pomocą
+ * kopca, jak przy mnożeniu wielomianów, i od razu scalane.
+ * @param[in] f : wielomian @f$f@f$
+ * @param[in] g : wielomian @f$g@f$
+ * @return @f$f * g@f$
+ */
+PolyFlat PolyFlatMul(const PolyFlat* f, const PolyFlat* g)
+{
+    assert(f && g);
+    size_t num_vars = max_size_t(f->num_vars, g->num_vars);
+    size_t capacity = f->size + g->size;
+    PolyFlat r = FlatWithCapacity(num_vars, capacity);
+    if (f->size == 0 || g->size == 0)
+    {
+        return r;
+    }
+    HeapNode* heap = malloc(f->size * sizeof(HeapNode));
+    CHECK_PTR(heap);
+    size_t heap_size = 0;
+    FlatHeapPush(heap, &heap_size, (HeapNode) {.i = 0, .j = 0}, f, g);
+    HeapNode previous = {.i = 0, .j = 0};
+
+    while (heap_size > 0)
+    {
+        HeapNode node = FlatHeapPop(heap, &heap_size, f, g);
+        if (node.j == 0 && node.i + 1 < f->size)
+        {
+            FlatHeapPush(heap, &heap_size,
+                (HeapNode) {.i = node.i + 1, .j = 0}, f, g);
+        }
+        if (node.j + 1 < g->size)
+        {
+            FlatHeapPush(heap, &heap_size,
+                (HeapNode) {.i = node.i, .j = node.j + 1}, f, g);
+        }
+
+        poly_coeff_t product = f->coeffs[node.i] * g->coeffs[node.j];
+        if (r.size > 0 && CompareFlatProducts(f, g, &previous, &node) == 0)
+        {
+            r.coeffs[r.size - 1] += product;
+            continue;
+        }
+        if (r.size > 0 && r.coeffs[r.size - 1] == 0)
+        {
+            r.size--;
+        }
+        FlatReserve(&r, &capacity);
+        for (size_t v = 0; v < num_vars; v++)
+        {
+            r.exps[r.size * num_vars + v] =
+                FlatExp(f, node.i, v) + FlatExp(g, node.j, v);
+        }
+        r.coeffs[r.size++] = product;
+        previous = node;
+    }
+    if (r.size > 0 && r.coeffs[r.size - 1] == 0)
+    {
+        r.size--;
+    }
+    free(heap);
+    return r;
+}
+
+/**
+ * Sprawdza równość dwóch wielomianów w postaci płaskiej.
+ * @param[in] f : wielomian @f$f@f$
+ * @param[in] g : wielomian @f$g@f$
+ * @return @f$f = g@f$
+ */
+bool PolyFlatIsEq(const PolyFlat* f, const PolyFlat* g)
+{
+    assert(f && g);
+    if (f->size != g->size)
+    {
+        return false;
+    }
+    if (f->num_vars == g->num_vars)
+    {
+        return memcmp(f->coeffs, g->coeffs, f->size * sizeof(poly_coeff_t)) == 0 &&
+            memcmp(f->exps, g->exps, f->size * f->num_vars * sizeof(poly_exp_t)) == 0;
+    }
+    for (size_t i = 0; i < f->size; i++)
+    {
+        if (f->coeffs[i] != g->coeffs[i] || CompareFlatRows(f, i, g, i) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+Liczby pierwsze 2^61 - 1 i 2^61 - 31, modulo których liczone sa wartosci
+wielomianów w probabilistycznym sprawdzaniu równosci. Ich iloczyn jest
+wiekszy niz 2^64, wiec zadna niezerowa róznica dwóch wspólczynników
+nie jest podzielna przez obie naraz.
+*/
+#define PRIME_MOD_1 ((UINT64_C(1) << 61) - 1)
+#define PRIME_MOD_2 ((UINT64_C(1) << 61) - 31) ///< druga liczba pierwsza
+
+/**
+Stan generatora liczb pseudolosowych dla PolyIsEqProbable.
+*/
+static _Thread_local uint64_t random_state = UINT64_C(0x853c49e6748fea9b);
+
+/**
+* Losuje liczbe z przedzialu [0, mod).
+* @param[in] mod: modul
+* @return wylosowana liczba
+*/
+static uint64_t RandomMod(uint64_t mod)
+{
+    random_state += UINT64_C(0x9e3779b97f4a7c15);
+    return MixBits(random_state) % mod;
+}
+
+/**
+* Redukuje liczbe 128-bitowa hi * 2^64 + lo modulo mod = 2^61 - c,
+* korzystajac z tego, ze 2^61 = c.
+* @param[in] hi: starsze 64 bity liczby, mniejsze niz 2^61
+* @param[in] lo: mlodsze 64 bity liczby
+* @param[in] mod: modul postaci 2^61 - c dla c < 2^32
+* @return liczba modulo mod
+*/
+static uint64_t ReduceMod(uint64_t hi, uint64_t lo, uint64_t mod)
+{
+    uint64_t c = (UINT64_C(1) << 61) - mod;
+    uint64_t mask = (UINT64_C(1) << 61) - 1;
+    while (hi != 0 || lo > mask)
+    {
+        uint64_t q = (hi << 3) | (lo >> 61);
+        uint64_t low_part = (q & UINT32_MAX) * c;
+        uint64_t high_part = (q >> 32) * c;
+        uint64_t sum = (lo & mask) + low_part;
+        hi = (high_part >> 32) + (sum < low_part);
+        lo = sum + (high_part << 32);
+        hi += (lo < sum);
+    }
+    return lo >= mod ? lo - mod : lo;
+}
+
+/**
+* Mnozy liczby modulo mod.
+* @param[in] a: liczba mniejsza niz mod
+* @param[in] b: liczba mniejsza niz mod
+* @param[in] mod: modul postaci 2^61 - c
+* @return a * b mod mod
+*/
+static uint64_t MulMod(uint64_t a, uint64_t b, uint64_t mod)
+{
+    uint64_t a_hi = a >> 32, a_lo = a & UINT32_MAX;
+    uint64_t b_hi = b >> 32, b_lo = b & UINT32_MAX;
+    uint64_t mid = a_hi * b_lo + a_lo * b_hi;
+    uint64_t lo = a_lo * b_lo;
+    uint64_t res_lo = lo + (mid << 32);
+    uint64_t res_hi = a_hi * b_hi + (mid >> 32) + (res_lo < lo);
+    return ReduceMod(res_hi, res_lo, mod);
+}
+
+/**
+* Podnosi liczbe do potegi modulo mod.
+* @param[in] base: podstawa mniejsza niz mod
+* @param[in] exp: wykladnik
+* @param[in] mod: modul postaci 2^61 - c
+* @return base^exp mod mod
+*/
+static uint64_t PowerMod(uint64_t base, poly_exp_t exp, uint64_t mod)
+{
+    uint64_t res = 1;
+    for (; exp > 0; exp /= 2)
+    {
+        if (exp % 2 == 1)
+        {
+            res = MulMod(res, base, mod);
+        }
+        base = MulMod(base, base, mod);
+    }
+    return res;
+}
+
+/**
+* Wylicza wartosc wielomianu modulo mod schematem Hornera.
+* @param[in] p: wielomian
+* @param[in] xs: wartosci zmiennych, poczawszy od zmiennej glównej p
+* @param[in] mod: modul postaci 2^61 - c
+* @return wartosc wielomianu modulo mod
+*/
+static uint64_t EvalMod(const Poly* p, const uint64_t* xs, uint64_t mod)
+{
+    if (PolyIsCoeff(p))
+    {
+        if (p->coeff >= 0)
+        {
+            return (uint64_t)p->coeff % mod;
+        }
+        uint64_t minus = ((uint64_t)(-(p->coeff + 1)) + 1) % mod;
+        return minus == 0 ? 0 : mod - minus;
+    }
+    size_t i = p->size - 1;
+    uint64_t res = EvalMod(&(p->arr[i].p), xs + 1, mod);
+    while (i > 0)
+    {
+        res = MulMod(res, PowerMod(xs[0], p->arr[i].exp - p->arr[i - 1].exp, mod), mod);
+        i--;
+        res = ReduceMod(0, res + EvalMod(&(p->arr[i].p), xs + 1, mod), mod);
+    }
+    return MulMod(res, PowerMod(xs[0], p->arr[0].exp, mod), mod);
+}
+
+/**
+ * Sprawdza probabilistycznie równość dwóch wielomianów (test
+ * Schwartza-Zippela). W każdej z @p rounds rund porównuje ich wartości
+ * modulo liczby pierwsze @f$2^{61}-1@f$ i @f$2^{61}-31@f$ w niezależnie
+ * wylosowanych punktach i uznaje je za równe, jeśli obie wartości się zgadzają.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] rounds : liczba losowanych punktów
+ * @return Czy wielomiany są prawdopodobnie równe?
+ */
+bool PolyIsEqProbable(const Poly* p, const Poly* q, unsigned int rounds)
+{
+    assert(p && q);
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    {
+        return p->coeff == q->coeff;
+    }
+    size_t num_vars = max_size_t(PolyDepth(p), PolyDepth(q));
+    uint64_t* xs = malloc(2 * num_vars * sizeof(uint64_t));
+    CHECK_PTR(xs);
+    uint64_t* ys = xs + num_vars;
+    bool equal = true;
+    for (unsigned int r = 0; r < rounds && equal; r++)
+    {
+        for (size_t v = 0; v < num_vars; v++)
+        {
+            xs[v] = RandomMod(PRIME_MOD_1);
+            ys[v] = RandomMod(PRIME_MOD_2);
+        }
+        equal = (EvalMod(p, xs, PRIME_MOD_1) == EvalMod(q, xs, PRIME_MOD_1)
+                 && EvalMod(p, ys, PRIME_MOD_2) == EvalMod(q, ys, PRIME_MOD_2));
+    }
+    free(xs);
+    return equal;
+}
+
+/**
+ * Zwraca górne ograniczenie prawdopodobieństwa, że PolyIsEqProbable
+ * uzna różne wielomiany za równe. Różnica różnych wielomianów jest niezerowa
+ * modulo co najmniej jedna z liczb pierwszych, więc ograniczenie liczone jest
+ * dla mniejszej z nich.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] rounds : liczba losowanych punktów
+ * @return ograniczenie prawdopodobieństwa błędu
+ */
+double PolyIsEqProbableError(const Poly* p, const Poly* q, unsigned int rounds)
+{
+    assert(p && q);
+    if (PolyIsCoeff(p) && PolyIsCoeff(q))
+    {
+        return 0;
+    }
+    double deg = max_poly_exp_t(PolyDeg(p), PolyDeg(q));
+    double error = 1;
+    for (unsigned int r = 0; r < rounds; r++)
+    {
+        error *= deg / (double)PRIME_MOD_2;
+    }
+    return error;
+}
+
+/**
+Rozmiar bufora, w którym PolyPrint sklada tekst przed zapisaniem go do strumienia.
+*/
+#define PRINT_BUFFER_SIZE 4096
+
+/**
+Maksymalna dlugosc zapisu dziesietnego liczby typu long, razem ze znakiem.
+*/
+#define MAX_NUMBER_LENGTH 21
+
+/**
+* Bufor, do którego dopisywany jest tekst lub zapis binarny wielomianu.
+*/
+typedef struct
+{
+    FILE* f; ///< strumien, do którego trafia zawartosc bufora
+    size_t len; ///< liczba zajetych znaków
+    char buf[PRINT_BUFFER_SIZE]; ///< zawartosc bufora
+}   PrintBuffer;
+
+/**
+* Zapisuje zawartosc bufora do strumienia i opróznia bufor.
+* @param[in] b: bufor
+*/
+static void PrintFlush(PrintBuffer* b)
+{
+    fwrite(b->buf, 1, b->len, b->f);
+    b->len = 0;
+}
+
+/**
+* Dopisuje znak do bufora.
+* @param[in] b: bufor
+* @param[in] c: znak
+*/
+static void PrintChar(PrintBuffer* b, char c)
+{
+    if (b->len == PRINT_BUFFER_SIZE)
+    {
+        PrintFlush(b);
+    }
+    b->buf[b->len++] = c;
+}
+
+/**
+* Dopisuje do bufora zapis dziesietny liczby.
+* Cyfry sa generowane od konca do pomocniczej tablicy, bez uzycia printf.
+* @param[in] b: bufor
+* @param[in] x: liczba
+*/
+static void PrintNumber(PrintBuffer* b, long x)
+{
+    char digits[MAX_NUMBER_LENGTH];
+    size_t pos = MAX_NUMBER_LENGTH;
+    unsigned long abs_x = x < 0 ? -(unsigned long)x : (unsigned long)x;
+    do
+    {
+        digits[--pos] = '0' + abs_x % 10;
+        abs_x /= 10;
+    } while (abs_x != 0);
+    if (x < 0)
+    {
+        digits[--pos] = '-';
+    }
+    if (b->len + (MAX_NUMBER_LENGTH - pos) > PRINT_BUFFER_SIZE)
+    {
+        PrintFlush(b);
+    }
+    memcpy(b->buf + b->len, digits + pos, MAX_NUMBER_LENGTH - pos);
+    b->len += MAX_NUMBER_LENGTH - pos;
+}
+
+/**
+* Dopisuje do bufora tekst wielomianu.
+* @param[in] b: bufor
+* @param[in] p: wielomian
+*/
+static void PrintPoly(PrintBuffer* b, const Poly* p)
+{
+    if (PolyIsCoeff(p))
+    {
+        PrintNumber(b, p->coeff);
+        return;
+    }
+    for (size_t i = 0; i < p->size; i++)
+    {
+        if (i != 0)
+        {
+            PrintChar(b, '+');
+        }
+        PrintChar(b, '(');
+        PrintPoly(b, &p->arr[i].p);
+        PrintChar(b, ',');
+        PrintNumber(b, p->arr[i].exp);
+        PrintChar(b, ')');
+    }
+}
+
+/**
+ * Wypisuje wielomian do strumienia w postaci akceptowanej przez kalkulator,
+ * bez znaku nowej linii na końcu. Tekst jest składany w buforze w jednym
+ * przebiegu, bez tworzenia napisów pośrednich.
+ * @param[in] f : strumień wyjściowy
+ * @param[in] p : wielomian
+ */
+void PolyPrint(FILE* f, const Poly* p)
+{
+    PrintBuffer b;
+    b.f = f;
+    b.len = 0;
+    PrintPoly(&b, p);
+    PrintFlush(&b);
+}
+
+/**
+Liczba bajtów zapisu wspólczynnika w formacie binarnym.
+*/
+#define COEFF_BYTES 8
+
+/**
+* Dopisuje do bufora liczbe w kodowaniu varint: po 7 bitów na bajt,
+* od najmniej znaczacych, z najstarszym bitem ustawionym we wszystkich
+* bajtach poza ostatnim.
+* @param[in] b: bufor
+* @param[in] x: liczba
+*/
+static void SerializeVarint(PrintBuffer* b, uint64_t x)
+{
+    while (x >= 0x80)
+    {
+        PrintChar(b, (char)(x & 0x7f) | (char)0x80);
+        x >>= 7;
+    }
+    PrintChar(b, (char)x);
+}
+
+/**
+* Dopisuje do bufora zapis binarny wielomianu.
+* @param[in] b: bufor
+* @param[in] p: wielomian
+*/
+static void SerializePoly(PrintBuffer* b, const Poly* p)
+{
+    if (PolyIsCoeff(p))
+    {
+        SerializeVarint(b, 0);
+        uint64_t coeff = (uint64_t)p->coeff;
+        for (size_t i = 0; i < COEFF_BYTES; i++)
+        {
+            PrintChar(b, (char)(coeff >> (8 * i)));
+        }
+        return;
+    }
+    SerializeVarint(b, p->size);
+    for (size_t i = 0; i < p->size; i++)
+    {
+        SerializeVarint(b, (uint64_t)p->arr[i].exp);
+        SerializePoly(b, &p->arr[i].p);
+    }
+}
+
+/**
+ * Zapisuje wielomian do strumienia w zwartym formacie binarnym.
+ * @param[in] f : strumień wyjściowy, otwarty w trybie binarnym
+ * @param[in] p : wielomian
+ * @return Czy zapis się powiódł?
+ */
+bool PolySerialize(FILE* f, const Poly* p)
+{
+    PrintBuffer b;
+    b.f = f;
+    b.len = 0;
+    SerializePoly(&b, p);
+    PrintFlush(&b);
+    return !ferror(f);
+}
+
+/**
+* Odczytuje ze strumienia liczbe zapisana w kodowaniu varint.
+* @param[in] f: strumien
+* @param[in] limit: maksymalna dopuszczalna wartosc
+* @param[out] x: odczytana liczba
+* @return czy odczyt sie powiódl i liczba nie przekracza limitu
+*/
+static bool DeserializeVarint(FILE* f, uint64_t limit, uint64_t* x)
+{
+    uint64_t res = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        int c = getc(f);
+        if (c == EOF)
+        {
+            return false;
+        }
+        if (shift == 63 && (c & 0x7e) != 0)
+        {
+            return false;
+        }
+        res |= (uint64_t)(c & 0x7f) << shift;
+        if ((c & 0x80) == 0)
+        {
+            *x = res;
+            return res <= limit;
+        }
+    }
+    return false;
+}
+
+/**
+Maksymalna glebokosc zagniezdzenia wielomianu odczytywanego przez
+PolyDeserialize. Chroni przed przepelnieniem stosu wywolan przez
+spreparowany plik, w którym kazdy poziom zajmuje tylko dwa bajty.
+*/
+#define MAX_DESERIALIZE_DEPTH 10000
+
+/**
+* Odczytuje ze strumienia zapis binarny wielomianu.
+* @param[in] f: strumien
+* @param[out] p: odczytany wielomian; w razie bledu wielomian zerowy
+* @param[in] depth: glebokosc zagniezdzenia odczytywanego wielomianu
+* @return czy odczyt sie powiódl
+*/
+static bool DeserializePoly(FILE* f, Poly* p, unsigned int depth)
+{
+    *p = PolyZero();
+    uint64_t size;
+    if (depth > MAX_DESERIALIZE_DEPTH || !DeserializeVarint(f, SIZE_MAX / sizeof(Mono), &size))
+    {
+        return false;
+    }
+    if (size == 0)
+    {
+        uint64_t coeff = 0;
+        for (size_t i = 0; i < COEFF_BYTES; i++)
+        {
+            int c = getc(f);
+            if (c == EOF)
+            {
+                return false;
+            }
+            coeff |= (uint64_t)c << (8 * i);
+        }
+        p->coeff = (poly_coeff_t)coeff;
+        return true;
+    }
+
+    // Tablica rosnie w miare odczytu, zeby urwane dane nie wymusily
+    // alokacji rozmiaru podanego w naglówku.
+    Poly r;
+    r.size = 0;
+    r.arr = MonosAlloc(1);
+    size_t capacity = 1;
+    bool correct = true;
+    while (r.size < size && correct)
+    {
+        uint64_t exp;
+        Mono m;
+        m.p = PolyZero();
+        correct = DeserializeVarint(f, INT_MAX, &exp)
+            && (r.size == 0 || (poly_exp_t)exp > r.arr[r.size - 1].exp)
+            && DeserializePoly(f, &m.p, depth + 1)
+            && !PolyIsZero(&m.p);
+        if (!correct)
+        {
+            PolyDestroy(&m.p);
+            break;
+        }
+        m.exp = (poly_exp_t)exp;
+        if (r.size == capacity)
+        {
+            r.arr = MonosRealloc(r.arr, capacity, 2 * capacity);
+            capacity *= 2;
+        }
+        r.arr[r.size++] = m;
+    }
+    if (!correct || PolyUnreduced(&r))
+    {
+        PolyDestroy(&r);
+        return false;
+    }
+    if (capacity != r.size)
+    {
+        r.arr = MonosRealloc(r.arr, capacity, r.size);
+    }
+    *p = r;
+    return true;
+}
+
+/**
+ * Odczytuje ze strumienia wielomian zapisany funkcją PolySerialize.
+ * Odrzuca dane urwane, niepoprawne lub zagnieżdżone zbyt głęboko;
+ * wtedy @p p jest wielomianem zerowym.
+ * @param[in] f : strumień wejściowy, otwarty w trybie binarnym
+ * @param[out] p : odczytany wielomian
+ * @return Czy odczyt się powiódł?
+ */
+bool PolyDeserialize(FILE* f, Poly* p)
+{
+    return DeserializePoly(f, p, 0);
+}
+
+/**
+* Ustawia arene, z której przydzielana jest pamiec wielomianów.
+* @param[in] a: arena lub NULL, aby przydzielac pamiec przez malloc
+* @return poprzednio ustawiona arena
+*/
+static PolyArena* ArenaSwitch(PolyArena* a)
+{
+    PolyArena* previous = current_arena;
+    current_arena = a;
+    return previous;
+}
+
+/**
+ * Robi pełną, głęboką kopię wielomianu w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian
+ * @return skopiowany wielomian
+ */
+Poly PolyCloneInArena(PolyArena* a, const Poly* p)
+{
+    assert(a);
+    PolyArena* previous = ArenaSwitch(a);
+    Poly res = PolyClone(p);
+    ArenaSwitch(previous);
+    return res;
+}
+
+/**
+ * Dodaje dwa wielomiany, budując wynik w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddInArena(PolyArena* a, const Poly* p, const Poly* q)
+{
+    assert(a);
+    PolyArena* previous = ArenaSwitch(a);
+    Poly res = PolyAdd(p, q);
+    ArenaSwitch(previous);
+    return res;
+}
+
+/**
+ * Mnoży dwa wielomiany, budując wynik w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulInArena(PolyArena* a, const Poly* p, const Poly* q)
+{
+    assert(a);
+    PolyArena* previous = ArenaSwitch(a);
+    Poly res = PolyMul(p, q);
+    ArenaSwitch(previous);
+    return res;
+}
+
+/**
+ * Wylicza wartość wielomianu w punkcie @p x, budując wynik w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return @f$p(x, x_0, x_1, \ldots)@f$
+ */
+Poly PolyAtInArena(PolyArena* a, const Poly* p, poly_coeff_t x)
+{
+    assert(a);
+    PolyArena* previous = ArenaSwitch(a);
+    Poly res = PolyAt(p, x);
+    ArenaSwitch(previous);
+    return res;
+}
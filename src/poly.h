@@ -12,6 +12,8 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
@@ -37,7 +39,11 @@ typedef struct Poly {
     poly_coeff_t coeff; ///< współczynnik
     size_t       size; ///< rozmiar wielomianu, liczba jednomianów
   };
-  /** To jest tablica przechowująca listę jednomianów. */
+  /**
+   * To jest tablica przechowująca listę jednomianów.
+   * Tablice tworzy i zwalnia wyłącznie biblioteka. Mogą być one
+   * współdzielone przez kopie wielomianu, więc nie wolno ich zmieniać.
+   */
   struct Mono *arr;
 } Poly;
 
@@ -125,14 +131,16 @@ static inline void MonoDestroy(Mono *m) {
 }
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Robi kopię wielomianu.
+ * Kopia współdzieli z oryginałem tablice jednomianów (są one kopiowane
+ * dopiero przy zmianie), więc operacja działa w czasie stałym.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
 Poly PolyClone(const Poly *p);
 
 /**
- * Robi pełną, głęboką kopię jednomianu.
+ * Robi kopię jednomianu.
  * @param[in] m : jednomian
  * @return skopiowany jednomian
  */
@@ -180,6 +188,42 @@ Poly PolyNeg(const Poly *p);
  */
 Poly PolySub(const Poly *p, const Poly *q);
 
+/**
+ * Dodaje dwa wielomiany, przenosząc ich jednomiany do wyniku
+ * zamiast je kopiować.
+ * Przejmuje na własność zawartość wielomianów @p p i @p q.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddOwned(Poly *p, Poly *q);
+
+/**
+ * Mnoży dwa wielomiany.
+ * Przejmuje na własność zawartość wielomianów @p p i @p q.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulOwned(Poly *p, Poly *q);
+
+/**
+ * Zwraca przeciwny wielomian, negując współczynniki w miejscu.
+ * Przejmuje na własność zawartość wielomianu @p p.
+ * @param[in] p : wielomian @f$p@f$
+ * @return @f$-p@f$
+ */
+Poly PolyNegOwned(Poly *p);
+
+/**
+ * Odejmuje wielomian od wielomianu, przenosząc ich jednomiany do wyniku.
+ * Przejmuje na własność zawartość wielomianów @p p i @p q.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p - q@f$
+ */
+Poly PolySubOwned(Poly *p, Poly *q);
+
 /**
  * Zwraca stopień wielomianu ze względu na zadaną zmienną (-1 dla wielomianu
  * tożsamościowo równego zeru). Zmienne indeksowane są od 0.
@@ -207,6 +251,45 @@ poly_exp_t PolyDeg(const Poly *p);
  */
 bool PolyIsEq(const Poly *p, const Poly *q);
 
+/**
+ * Sprawdza probabilistycznie równość dwóch wielomianów (test
+ * Schwartza-Zippela). Porównuje ich wartości modulo liczby pierwsze
+ * @f$2^{61}-1@f$ i @f$2^{61}-31@f$ w @p rounds losowych punktach, bez
+ * przechodzenia po obu drzewach naraz. Iloczyn tych liczb przekracza
+ * @f$2^{64}@f$, więc żadna niezerowa różnica współczynników nie znika
+ * modulo obie naraz.
+ * Równe wielomiany zawsze są uznawane za równe. Różne mogą zostać uznane
+ * za równe z prawdopodobieństwem nie większym niż
+ * PolyIsEqProbableError(p, q, rounds).
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] rounds : liczba losowanych punktów
+ * @return Czy wielomiany są prawdopodobnie równe?
+ */
+bool PolyIsEqProbable(const Poly *p, const Poly *q, unsigned int rounds);
+
+/**
+ * Zwraca górne ograniczenie prawdopodobieństwa, że PolyIsEqProbable
+ * uzna różne wielomiany za równe: @f$(d / (2^{61}-31))^{rounds}@f$,
+ * gdzie @f$d@f$ jest większym ze stopni wielomianów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] rounds : liczba losowanych punktów
+ * @return ograniczenie prawdopodobieństwa błędu
+ */
+double PolyIsEqProbableError(const Poly *p, const Poly *q, unsigned int rounds);
+
+/**
+ * Zwraca 64-bitowy skrót wielomianu zależny tylko od jego wartości,
+ * np. do użycia jako klucz w pamięci podręcznej.
+ * Równe wielomiany mają równe skróty.
+ * Dla wielomianów niebędących współczynnikami skrót jest wyliczany raz,
+ * przy pierwszym użyciu, i zapamiętywany.
+ * @param[in] p : wielomian
+ * @return skrót wielomianu
+ */
+uint64_t PolyHash(const Poly *p);
+
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -220,4 +303,257 @@ bool PolyIsEq(const Poly *p, const Poly *q);
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Wylicza wartości wielomianu w wielu punktach naraz.
+ * Dla każdego @f$k@f$ wstawia do @p out[k] wielomian PolyAt(p, xs[k]).
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] xs : tablica argumentów
+ * @param[in] n : liczba argumentów
+ * @param[out] out : tablica wyników
+ */
+void PolyAtMany(const Poly *p, const poly_coeff_t xs[], size_t n, Poly out[]);
+
+/**
+ * Wylicza wartości liczbowe wielomianu w wielu punktach naraz,
+ * wstawiając wartości pod wszystkie zmienne.
+ * Wartość zmiennej @f$x_v@f$ w @f$k@f$-tym punkcie to `xs[v * n + k]`.
+ * Zmienne o indeksach nie mniejszych niż @p num_vars mają wartość 0.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] num_vars : liczba zmiennych, których wartości są w @p xs
+ * @param[in] n : liczba punktów
+ * @param[in] xs : wartości zmiennych
+ * @param[out] out : tablica @p n wyników
+ */
+void PolyEvalBatch(const Poly *p, size_t num_vars, size_t n,
+                   const poly_coeff_t xs[], poly_coeff_t out[]);
+
+/**
+ * To jest typ reprezentujący wielomian skompilowany do płaskiego programu,
+ * który wylicza jego wartość liczbową bez przechodzenia po drzewie
+ * jednomianów i bez alokowania pamięci: bufor roboczy dostarcza wywołujący.
+ */
+typedef struct PolyProgram PolyProgram;
+
+/**
+ * Kompiluje wielomian do płaskiego programu obliczającego jego wartość.
+ * Program nie zależy od wielomianu @p p po zakończeniu kompilacji.
+ * @param[in] p : wielomian
+ * @return program
+ */
+PolyProgram* PolyCompile(const Poly *p);
+
+/**
+ * Usuwa program z pamięci.
+ * @param[in] prog : program
+ */
+void PolyProgramDestroy(PolyProgram *prog);
+
+/**
+ * Zwraca rozmiar bufora roboczego potrzebnego funkcji PolyProgramEval.
+ * Jest on znany po kompilacji, więc bufor można przydzielić raz
+ * i używać go przy kolejnych wywołaniach.
+ * @param[in] prog : program
+ * @return liczba elementów typu poly_coeff_t
+ */
+size_t PolyProgramScratchSize(const PolyProgram *prog);
+
+/**
+ * Wylicza wartość liczbową skompilowanego wielomianu,
+ * wstawiając wartości pod wszystkie zmienne. Nie alokuje pamięci.
+ * Zmienne o indeksach nie mniejszych niż @p num_vars mają wartość 0.
+ * Bufor roboczy może być używany przez jeden wątek naraz.
+ * @param[in] prog : program
+ * @param[in] xs : wartości zmiennych @f$x_0, x_1, \ldots@f$
+ * @param[in] num_vars : liczba zmiennych, których wartości są w @p xs
+ * @param[in] scratch : bufor roboczy o co najmniej
+ * PolyProgramScratchSize(prog) elementach
+ * @return wartość wielomianu
+ */
+poly_coeff_t PolyProgramEval(const PolyProgram *prog, const poly_coeff_t xs[],
+                             size_t num_vars, poly_coeff_t scratch[]);
+
+/**
+ * To jest struktura przechowująca wielomian w postaci płaskiej.
+ * Wielomian jest sumą wyrazów @f$c x_0^{e_0} x_1^{e_1} \ldots@f$
+ * o niezerowych współczynnikach @f$c@f$, zapisanych w równoległych tablicach
+ * posortowanych leksykograficznie względem wektorów wykładników.
+ * Wielomian zerowy nie ma żadnego wyrazu.
+ */
+typedef struct PolyFlat {
+  size_t size; ///< liczba wyrazów
+  size_t num_vars; ///< długość wektorów wykładników
+  /**
+   * To jest tablica wektorów wykładników, wiersz po wierszu.
+   * Wykładnik zmiennej @f$x_v@f$ w @f$i@f$-tym wyrazie to
+   * `exps[i * num_vars + v]`.
+   */
+  poly_exp_t *exps;
+  poly_coeff_t *coeffs; ///< tablica współczynników wyrazów
+} PolyFlat;
+
+/**
+ * Zamienia wielomian na postać płaską.
+ * @param[in] p : wielomian
+ * @return wielomian w postaci płaskiej
+ */
+PolyFlat PolyToFlat(const Poly *p);
+
+/**
+ * Zamienia wielomian w postaci płaskiej na wielomian.
+ * @param[in] f : wielomian w postaci płaskiej
+ * @return wielomian
+ */
+Poly PolyFromFlat(const PolyFlat *f);
+
+/**
+ * Usuwa wielomian w postaci płaskiej z pamięci.
+ * @param[in] f : wielomian w postaci płaskiej
+ */
+void PolyFlatDestroy(PolyFlat *f);
+
+/**
+ * Dodaje dwa wielomiany w postaci płaskiej.
+ * @param[in] f : wielomian @f$f@f$
+ * @param[in] g : wielomian @f$g@f$
+ * @return @f$f + g@f$
+ */
+PolyFlat PolyFlatAdd(const PolyFlat *f, const PolyFlat *g);
+
+/**
+ * Mnoży dwa wielomiany w postaci płaskiej.
+ * @param[in] f : wielomian @f$f@f$
+ * @param[in] g : wielomian @f$g@f$
+ * @return @f$f * g@f$
+ */
+PolyFlat PolyFlatMul(const PolyFlat *f, const PolyFlat *g);
+
+/**
+ * Sprawdza równość dwóch wielomianów w postaci płaskiej.
+ * @param[in] f : wielomian @f$f@f$
+ * @param[in] g : wielomian @f$g@f$
+ * @return @f$f = g@f$
+ */
+bool PolyFlatIsEq(const PolyFlat *f, const PolyFlat *g);
+
+/**
+ * Wypisuje wielomian do strumienia w postaci akceptowanej przez kalkulator,
+ * np. `((1,2)+(-3,0),1)`, bez znaku nowej linii na końcu.
+ * Tekst jest generowany w jednym przebiegu, bez tworzenia napisów pośrednich.
+ * @param[in] f : strumień wyjściowy
+ * @param[in] p : wielomian
+ */
+void PolyPrint(FILE *f, const Poly *p);
+
+/**
+ * Zapisuje wielomian do strumienia w zwartym formacie binarnym.
+ * Wielomian jest zapisywany w porządku preorder: liczba jednomianów
+ * (0 dla współczynnika) jako varint, a dalej albo 8 bajtów współczynnika
+ * w kolejności little-endian, albo kolejne jednomiany - wykładnik jako
+ * varint i rekurencyjnie zapisany współczynnik.
+ * @param[in] f : strumień wyjściowy, otwarty w trybie binarnym
+ * @param[in] p : wielomian
+ * @return Czy zapis się powiódł?
+ */
+bool PolySerialize(FILE *f, const Poly *p);
+
+/**
+ * Odczytuje ze strumienia wielomian zapisany funkcją PolySerialize.
+ * Odrzuca dane urwane lub niebędące poprawnym wielomianem w postaci
+ * znormalizowanej, a także wielomiany zagnieżdżone głębiej niż
+ * 10000 poziomów; wtedy @p p jest wielomianem zerowym.
+ * @param[in] f : strumień wejściowy, otwarty w trybie binarnym
+ * @param[out] p : odczytany wielomian
+ * @return Czy odczyt się powiódł?
+ */
+bool PolyDeserialize(FILE *f, Poly *p);
+
+/**
+ * To jest typ reprezentujący arenę - obszar pamięci, w którym można budować
+ * wielomiany i zwolnić je wszystkie naraz.
+ * Wielomianów zbudowanych w arenie nie wolno usuwać funkcją PolyDestroy
+ * ani przekazywać na własność funkcjom z przyrostkiem Owned.
+ * Przestają one istnieć po wywołaniu PolyArenaReset lub PolyArenaRelease.
+ * Można ich używać jako argumentów operacji poza areną: kopia
+ * (@ref PolyClone) i wyniki takich operacji nie odwołują się do pamięci
+ * areny, więc przetrwają jej zwolnienie.
+ */
+typedef struct PolyArena PolyArena;
+
+/**
+ * Tworzy pustą arenę.
+ * @return wskaźnik na arenę
+ */
+PolyArena* PolyArenaCreate(void);
+
+/**
+ * Zwalnia arenę razem ze wszystkimi zbudowanymi w niej wielomianami.
+ * @param[in] a : arena
+ */
+void PolyArenaRelease(PolyArena *a);
+
+/**
+ * Niszczy wszystkie wielomiany zbudowane w arenie,
+ * zachowując część jej pamięci do ponownego użycia.
+ * @param[in] a : arena
+ */
+void PolyArenaReset(PolyArena *a);
+
+/**
+ * Przydziela fragment pamięci z areny, np. na tablicę jednomianów
+ * budowanego w niej wielomianu.
+ * @param[in] a : arena
+ * @param[in] size : rozmiar fragmentu w bajtach
+ * @return wskaźnik na fragment pamięci
+ */
+void* PolyArenaAlloc(PolyArena *a, size_t size);
+
+/**
+ * Robi pełną, głęboką kopię wielomianu w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian
+ * @return skopiowany wielomian
+ */
+Poly PolyCloneInArena(PolyArena *a, const Poly *p);
+
+/**
+ * Dodaje dwa wielomiany, budując wynik w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+Poly PolyAddInArena(PolyArena *a, const Poly *p, const Poly *q);
+
+/**
+ * Mnoży dwa wielomiany, budując wynik w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+Poly PolyMulInArena(PolyArena *a, const Poly *p, const Poly *q);
+
+/**
+ * Wylicza wartość wielomianu w punkcie @p x, budując wynik w arenie.
+ * @param[in] a : arena
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return @f$p(x, x_0, x_1, \ldots)@f$
+ */
+Poly PolyAtInArena(PolyArena *a, const Poly *p, poly_coeff_t x);
+
+/**
+ * Ustawia liczbę wątków, na których biblioteka wykonuje równolegle
+ * kosztowne operacje, np. mnożenie dużych wielomianów.
+ * Domyślnie wszystkie operacje są wykonywane w wątku wywołującym.
+ * Wyniki są identyczne jak przy obliczeniach sekwencyjnych.
+ * Funkcji nie wolno wywoływać w trakcie innych operacji na wielomianach.
+ * Operacje w arenie są zawsze wykonywane sekwencyjnie.
+ * Niezależnie od tej funkcji kopie wielomianu utworzone przez @ref PolyClone
+ * można używać i usuwać w różnych wątkach, ale jednego obiektu wielomianu
+ * nie wolno używać jednocześnie w kilku wątkach.
+ * @param[in] threads : liczba wątków; 0 lub 1 wyłącza obliczenia równoległe
+ */
+void PolySetThreads(unsigned int threads);
+
 #endif /* __POLY_H__ */
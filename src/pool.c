@@ -0,0 +1,340 @@
+/** @file
+  Implementacja puli watków z podkradaniem zadan.
+  Kazdy watek ma wlasna kolejke dwustronna: zadania zleca i pobiera z jej
+  konca, a bezczynne watki podkradaja najstarsze zadania z poczatku kolejek
+  pozostalych watków.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#define _XOPEN_SOURCE 700 ///< aby znalezc potrzebne funkcje
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "pool.h"
+
+/**
+Sprawdza, czy alokacja sie powiodla.
+*/
+#define CHECK_PTR(p)    	\
+	do {			    	\
+		if (p == NULL) {	\
+			exit(1);		\
+		}					\
+	} while (0)
+
+/**
+Liczba prób znalezienia zadania, po których PoolWait przestaje aktywnie
+czekac i usypia do zakonczenia którejs z grup.
+*/
+#define SPIN_LIMIT 64
+
+/**
+Numer kolejki watku, który nie jest watkiem roboczym puli.
+*/
+#define EXTERNAL_WORKER SIZE_MAX
+
+/**
+* Zadanie do wykonania przez pule.
+*/
+typedef struct
+{
+    void (*run)(void*); ///< funkcja wykonujaca zadanie
+    void* arg; ///< argument funkcji
+    PoolGroup* group; ///< grupa, do której nalezy zadanie
+}   PoolTask;
+
+/**
+* Kolejka dwustronna zadan jednego watku.
+*/
+typedef struct
+{
+    pthread_mutex_t lock; ///< blokada chroniaca kolejke
+    PoolTask* tasks; ///< tablica zadan
+    size_t beg; ///< numer najstarszego zadania
+    size_t end; ///< numer za najnowszym zadaniem
+    size_t capacity; ///< zaalokowany rozmiar tablicy
+}   PoolDeque;
+
+/**
+* Pula watków.
+*/
+typedef struct
+{
+    size_t num_workers; ///< liczba watków roboczych
+    pthread_t* threads; ///< watki robocze
+    PoolDeque* deques; ///< kolejki watków roboczych i, na koncu, watków spoza puli
+    atomic_size_t queued; ///< liczba zadan czekajacych w kolejkach
+    atomic_bool stopping; ///< czy pula jest zatrzymywana
+    pthread_mutex_t sleep_lock; ///< blokada do usypiania bezczynnych watków
+    pthread_cond_t wake; ///< sygnal o nowym zadaniu lub zatrzymaniu puli
+    atomic_size_t waiters; ///< liczba watków uspionych w PoolWait
+    pthread_mutex_t done_lock; ///< blokada do usypiania watków w PoolWait
+    pthread_cond_t done; ///< sygnal o zakonczeniu wszystkich zadan którejs grupy
+}   Pool;
+
+/**
+Dzialajaca pula lub NULL.
+*/
+static Pool* pool = NULL;
+
+/**
+Numer watku roboczego, w którym wykonuje sie kod, lub EXTERNAL_WORKER.
+*/
+static _Thread_local size_t worker_index = EXTERNAL_WORKER;
+
+/**
+* Zwraca kolejke biezacego watku.
+* @return kolejka
+*/
+static PoolDeque* OwnDeque(void)
+{
+    size_t i = (worker_index == EXTERNAL_WORKER) ? pool->num_workers : worker_index;
+    return &pool->deques[i];
+}
+
+/**
+* Dopisuje zadanie na koniec kolejki.
+* @param[in] d: kolejka
+* @param[in] task: zadanie
+*/
+static void DequePush(PoolDeque* d, PoolTask task)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->beg == d->end)
+    {
+        d->beg = d->end = 0;
+    }
+    if (d->end == d->capacity)
+    {
+        d->capacity = (d->capacity == 0) ? 16 : 2 * d->capacity;
+        d->tasks = realloc(d->tasks, d->capacity * sizeof(PoolTask));
+        CHECK_PTR(d->tasks);
+    }
+    d->tasks[d->end++] = task;
+    pthread_mutex_unlock(&d->lock);
+}
+
+/**
+* Pobiera zadanie z kolejki: najnowsze, jesli to wlasna kolejka watku,
+* a najstarsze, jesli zadanie jest podkradane.
+* @param[in] d: kolejka
+* @param[in] steal: czy zadanie jest podkradane
+* @param[out] task: pobrane zadanie
+* @return czy kolejka zawierala zadanie
+*/
+static bool DequePop(PoolDeque* d, bool steal, PoolTask* task)
+{
+    pthread_mutex_lock(&d->lock);
+    bool found = d->beg < d->end;
+    if (found)
+    {
+        *task = steal ? d->tasks[d->beg++] : d->tasks[--d->end];
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/**
+* Zmniejsza liczbe niezakonczonych zadan grupy. Jesli spadla do zera,
+* budzi watki uspione w PoolWait.
+* @param[in] g: grupa
+*/
+static void GroupFinish(PoolGroup* g)
+{
+    if (atomic_fetch_sub(&g->pending, 1) == 1 && pool != NULL
+        && atomic_load(&pool->waiters) > 0)
+    {
+        pthread_mutex_lock(&pool->done_lock);
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->done_lock);
+    }
+}
+
+/**
+* Wykonuje jedno zadanie z wlasnej kolejki albo podkradzione innemu watkowi.
+* @return czy znaleziono zadanie
+*/
+static bool RunOneTask(void)
+{
+    if (atomic_load(&pool->queued) == 0)
+    {
+        return false;
+    }
+    size_t num_deques = pool->num_workers + 1;
+    size_t own = OwnDeque() - pool->deques;
+    PoolTask task;
+    bool found = DequePop(&pool->deques[own], false, &task);
+    for (size_t k = 1; k < num_deques && !found; k++)
+    {
+        found = DequePop(&pool->deques[(own + k) % num_deques], true, &task);
+    }
+    if (!found)
+    {
+        return false;
+    }
+    atomic_fetch_sub(&pool->queued, 1);
+    task.run(task.arg);
+    GroupFinish(task.group);
+    return true;
+}
+
+/**
+* Petla watku roboczego: wykonuje zadania, a gdy ich brak, usypia.
+* @param[in] arg: numer watku
+* @return NULL
+*/
+static void* WorkerMain(void* arg)
+{
+    worker_index = (size_t)(uintptr_t)arg;
+    while (!atomic_load(&pool->stopping))
+    {
+        if (RunOneTask())
+        {
+            continue;
+        }
+        pthread_mutex_lock(&pool->sleep_lock);
+        while (atomic_load(&pool->queued) == 0 && !atomic_load(&pool->stopping))
+        {
+            pthread_cond_wait(&pool->wake, &pool->sleep_lock);
+        }
+        pthread_mutex_unlock(&pool->sleep_lock);
+    }
+    return NULL;
+}
+
+void PoolStart(size_t threads)
+{
+    PoolStop();
+    if (threads == 0)
+    {
+        return;
+    }
+    pool = malloc(sizeof(Pool));
+    CHECK_PTR(pool);
+    pool->num_workers = threads;
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->stopping, false);
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    atomic_init(&pool->waiters, 0);
+    pthread_mutex_init(&pool->done_lock, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->deques = calloc(threads + 1, sizeof(PoolDeque));
+    CHECK_PTR(pool->deques);
+    for (size_t i = 0; i <= threads; i++)
+    {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    pool->threads = malloc(threads * sizeof(pthread_t));
+    CHECK_PTR(pool->threads);
+    for (size_t i = 0; i < threads; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, WorkerMain, (void*)(uintptr_t)i) != 0)
+        {
+            exit(1);
+        }
+    }
+}
+
+void PoolStop(void)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pool->sleep_lock);
+    atomic_store(&pool->stopping, true);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+    for (size_t i = 0; i < pool->num_workers; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (size_t i = 0; i <= pool->num_workers; i++)
+    {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->sleep_lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->done_lock);
+    pthread_cond_destroy(&pool->done);
+    free(pool->deques);
+    free(pool->threads);
+    free(pool);
+    pool = NULL;
+}
+
+size_t PoolThreads(void)
+{
+    return (pool == NULL) ? 0 : pool->num_workers;
+}
+
+void PoolGroupInit(PoolGroup* g)
+{
+    atomic_init(&g->pending, 0);
+}
+
+void PoolGroupHold(PoolGroup* g)
+{
+    atomic_fetch_add(&g->pending, 1);
+}
+
+void PoolGroupRelease(PoolGroup* g)
+{
+    GroupFinish(g);
+}
+
+void PoolSpawn(PoolGroup* g, void (*run)(void*), void* arg)
+{
+    atomic_fetch_add(&g->pending, 1);
+    atomic_fetch_add(&pool->queued, 1);
+    DequePush(OwnDeque(), (PoolTask) {.run = run, .arg = arg, .group = g});
+    pthread_mutex_lock(&pool->sleep_lock);
+    pthread_cond_signal(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+}
+
+/**
+* Usypia watek do zakonczenia którejs z grup, o ile grupa g ma niezakonczone
+* zadania, a w kolejkach nie ma zadan, które watek móglby wykonac.
+* Zadania grupy sa wtedy wykonywane przez inne watki, wiec ten, który
+* zakonczy ostatnie z nich, obudzi czekajacych.
+* @param[in] g: grupa
+*/
+static void WaitForGroups(PoolGroup* g)
+{
+    pthread_mutex_lock(&pool->done_lock);
+    atomic_fetch_add(&pool->waiters, 1);
+    while (atomic_load(&g->pending) > 0 && atomic_load(&pool->queued) == 0)
+    {
+        pthread_cond_wait(&pool->done, &pool->done_lock);
+    }
+    atomic_fetch_sub(&pool->waiters, 1);
+    pthread_mutex_unlock(&pool->done_lock);
+}
+
+void PoolWait(PoolGroup* g)
+{
+    unsigned int spins = 0;
+    while (atomic_load(&g->pending) > 0)
+    {
+        if (RunOneTask())
+        {
+            spins = 0;
+        }
+        else if (spins < SPIN_LIMIT)
+        {
+            spins++;
+            sched_yield();
+        }
+        else
+        {
+            WaitForGroups(g);
+            spins = 0;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+/** @file
+  Interfejs puli watków z podkradaniem zadan, uzywanej przez biblioteke
+  wielomianów do zrównoleglania kosztownych operacji.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+* Grupa zadan, na których zakonczenie mozna poczekac funkcja PoolWait.
+*/
+typedef struct
+{
+    atomic_size_t pending; ///< liczba niezakonczonych zadan grupy
+}   PoolGroup;
+
+/**
+* Uruchamia pule watków roboczych. Jesli pula juz dziala, najpierw ja zatrzymuje.
+* @param[in] threads: liczba watków roboczych; dla 0 pula nie jest uruchamiana
+*/
+void PoolStart(size_t threads);
+
+/**
+* Zatrzymuje pule watków i zwalnia jej zasoby.
+* Nie moze byc wtedy zadnych niezakonczonych zadan.
+*/
+void PoolStop(void);
+
+/**
+* Zwraca liczbe watków roboczych puli.
+* @return liczba watków lub 0, jesli pula nie dziala
+*/
+size_t PoolThreads(void);
+
+/**
+* Tworzy pusta grupe zadan.
+* @param[out] g: grupa
+*/
+void PoolGroupInit(PoolGroup* g);
+
+/**
+* Zatrzymuje grupe: PoolWait nie zakonczy sie przed odpowiadajacym
+* wywolaniem PoolGroupRelease, nawet jesli grupa nie ma zadnych zadan.
+* Pozwala czekac na zadanie, które zostanie zlecone dopiero pózniej.
+* @param[in] g: grupa
+*/
+void PoolGroupHold(PoolGroup* g);
+
+/**
+* Zwalnia grupe zatrzymana funkcja PoolGroupHold.
+* @param[in] g: grupa
+*/
+void PoolGroupRelease(PoolGroup* g);
+
+/**
+* Zleca wykonanie zadania w ramach grupy.
+* Zadanie trafia do kolejki biezacego watku, skad moga je podkrasc
+* pozostale watki. Pula musi dzialac.
+* @param[in] g: grupa zadania
+* @param[in] run: funkcja wykonujaca zadanie
+* @param[in] arg: argument funkcji
+*/
+void PoolSpawn(PoolGroup* g, void (*run)(void*), void* arg);
+
+/**
+* Czeka na zakonczenie wszystkich zadan grupy.
+* W trakcie oczekiwania wykonuje zadania z kolejek, wiec mozna ja wolac
+* takze z wnetrza zadania.
+* @param[in] g: grupa
+*/
+void PoolWait(PoolGroup* g);
+
+#endif /* __POOL_H__ */
@@ -0,0 +1,167 @@
+/** @file
+  Implementacja ograniczonej kolejki z jednym producentem i jednym konsumentem.
+  Elementy leza w buforze cyklicznym, a producent i konsument przesuwaja
+  wlasne liczniki atomowo. Blokada i zmienne warunkowe sa uzywane tylko
+  wtedy, gdy któras strona musi zasnac.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#define _XOPEN_SOURCE 700 ///< aby znalezc potrzebne funkcje
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "queue.h"
+
+/**
+Sprawdza, czy alokacja sie powiodla.
+*/
+#define CHECK_PTR(p)    	\
+	do {			    	\
+		if (p == NULL) {	\
+			exit(1);		\
+		}					\
+	} while (0)
+
+/**
+Liczba prób aktywnego oczekiwania przed uspieniem watku.
+*/
+#define SPIN_LIMIT 64
+
+/**
+Rozmiar linii pamieci podrecznej; liczniki obu stron leza w osobnych liniach.
+*/
+#define CACHE_LINE 64
+
+struct Queue
+{
+    _Alignas(CACHE_LINE) atomic_size_t head; ///< liczba pobranych elementów
+    _Alignas(CACHE_LINE) atomic_size_t tail; ///< liczba wstawionych elementów
+    _Alignas(CACHE_LINE) atomic_bool consumer_waiting; ///< czy konsument spi
+    atomic_bool producer_waiting; ///< czy producent spi
+    size_t elem_size; ///< rozmiar elementu
+    size_t mask; ///< pojemnosc kolejki pomniejszona o 1
+    char* data; ///< bufor cykliczny
+    pthread_mutex_t lock; ///< blokada do usypiania
+    pthread_cond_t not_empty; ///< sygnal dla konsumenta
+    pthread_cond_t not_full; ///< sygnal dla producenta
+};
+
+Queue* QueueCreate(size_t elem_size, size_t capacity)
+{
+    Queue* q = aligned_alloc(CACHE_LINE, (sizeof(Queue) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE);
+    CHECK_PTR(q);
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size *= 2;
+    }
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->consumer_waiting, false);
+    atomic_init(&q->producer_waiting, false);
+    q->elem_size = elem_size;
+    q->mask = size - 1;
+    q->data = malloc(size * elem_size);
+    CHECK_PTR(q->data);
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+    return q;
+}
+
+void QueueDestroy(Queue* q)
+{
+    pthread_mutex_destroy(&q->lock);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->data);
+    free(q);
+}
+
+/**
+* Czeka, az warunek przestanie byc spelniony: najpierw aktywnie,
+* potem usypiajac na zmiennej warunkowej.
+* @param[in] q: kolejka
+* @param[in] waiting: flaga oznaczajaca spiaca strone
+* @param[in] cond: zmienna warunkowa, na której spi ta strona
+* @param[in] blocked: funkcja sprawdzajaca, czy trzeba dalej czekac
+*/
+static void WaitWhile(Queue* q, atomic_bool* waiting, pthread_cond_t* cond,
+                      bool (*blocked)(Queue*))
+{
+    for (int i = 0; i < SPIN_LIMIT; i++)
+    {
+        if (!blocked(q))
+        {
+            return;
+        }
+        sched_yield();
+    }
+    pthread_mutex_lock(&q->lock);
+    atomic_store(waiting, true);
+    while (blocked(q))
+    {
+        pthread_cond_wait(cond, &q->lock);
+    }
+    atomic_store(waiting, false);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+* Budzi druga strone kolejki, jesli spi.
+* @param[in] q: kolejka
+* @param[in] waiting: flaga oznaczajaca spiaca strone
+* @param[in] cond: zmienna warunkowa, na której spi ta strona
+*/
+static void WakeUp(Queue* q, atomic_bool* waiting, pthread_cond_t* cond)
+{
+    if (atomic_load(waiting))
+    {
+        pthread_mutex_lock(&q->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
+/**
+* Sprawdza, czy kolejka jest pelna.
+* @param[in] q: kolejka
+* @return bool
+*/
+static bool IsFull(Queue* q)
+{
+    return atomic_load(&q->tail) - atomic_load(&q->head) > q->mask;
+}
+
+/**
+* Sprawdza, czy kolejka jest pusta.
+* @param[in] q: kolejka
+* @return bool
+*/
+static bool IsEmpty(Queue* q)
+{
+    return atomic_load(&q->tail) == atomic_load(&q->head);
+}
+
+void QueuePush(Queue* q, const void* elem)
+{
+    WaitWhile(q, &q->producer_waiting, &q->not_full, IsFull);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    memcpy(q->data + (tail & q->mask) * q->elem_size, elem, q->elem_size);
+    atomic_store(&q->tail, tail + 1);
+    WakeUp(q, &q->consumer_waiting, &q->not_empty);
+}
+
+void QueuePop(Queue* q, void* elem)
+{
+    WaitWhile(q, &q->consumer_waiting, &q->not_empty, IsEmpty);
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    memcpy(elem, q->data + (head & q->mask) * q->elem_size, q->elem_size);
+    atomic_store(&q->head, head + 1);
+    WakeUp(q, &q->producer_waiting, &q->not_full);
+}
@@ -0,0 +1,49 @@
+/** @file
+  Interfejs ograniczonej kolejki z jednym producentem i jednym konsumentem,
+  laczacej etapy potoku kalkulatora.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#ifndef __QUEUE_H__
+#define __QUEUE_H__
+
+#include <stddef.h>
+
+/**
+* Kolejka elementów stalego rozmiaru. Wstawiac do niej moze tylko jeden
+* watek i tylko jeden watek moze z niej pobierac. Szybka sciezka nie uzywa
+* blokad; watek czekajacy na miejsce lub na element usypia dopiero po
+* krótkim aktywnym oczekiwaniu.
+*/
+typedef struct Queue Queue;
+
+/**
+* Tworzy pusta kolejke.
+* @param[in] elem_size: rozmiar elementu w bajtach
+* @param[in] capacity: pojemnosc kolejki; zaokraglana w góre do potegi dwójki
+* @return kolejka
+*/
+Queue* QueueCreate(size_t elem_size, size_t capacity);
+
+/**
+* Usuwa kolejke. Nie niszczy elementów, które w niej pozostaly.
+* @param[in] q: kolejka
+*/
+void QueueDestroy(Queue* q);
+
+/**
+* Wstawia kopie elementu na koniec kolejki, czekajac, az zwolni sie miejsce.
+* @param[in] q: kolejka
+* @param[in] elem: element
+*/
+void QueuePush(Queue* q, const void* elem);
+
+/**
+* Pobiera element z poczatku kolejki, czekajac, az sie pojawi.
+* @param[in] q: kolejka
+* @param[out] elem: miejsce na pobrany element
+*/
+void QueuePop(Queue* q, void* elem);
+
+#endif /* __QUEUE_H__ */
@@ -0,0 +1,212 @@
+/** @file
+  Implementacja statystyk czasu wykonania polecen kalkulatora.
+  Liczniki i histogramy sa aktualizowane atomowo, a zdarzenia sladu
+  trafiaja do wspólnej tablicy chronionej blokada i sa zapisywane
+  do pliku dopiero na koncu dzialania programu.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#define _XOPEN_SOURCE 700 ///< aby znalezc potrzebne funkcje
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "stats.h"
+
+/**
+Sprawdza, czy alokacja sie powiodla.
+*/
+#define CHECK_PTR(p)    	\
+	do {			    	\
+		if (p == NULL) {	\
+			exit(1);		\
+		}					\
+	} while (0)
+
+/**
+* Zdarzenie sladu: jedno wywolanie polecenia.
+*/
+typedef struct
+{
+    const char* name; ///< nazwa rodzaju polecenia
+    uint64_t start; ///< chwila rozpoczecia
+    uint64_t duration; ///< czas trwania
+    unsigned int thread; ///< numer watku
+    unsigned int num_of_lines; ///< numer linijki
+}   TraceEvent;
+
+/**
+Czy statystyki sa zbierane.
+*/
+static bool enabled = false;
+
+/**
+Plik na slad lub NULL, jesli slad nie jest zbierany.
+*/
+static const char* trace_path = NULL;
+
+/**
+Chwila wlaczenia statystyk, od której liczone sa czasy w sladzie.
+*/
+static uint64_t trace_origin;
+
+/**
+Zdarzenia sladu.
+*/
+static TraceEvent* events = NULL;
+
+/**
+Liczba zdarzen sladu.
+*/
+static size_t num_events = 0;
+
+/**
+Zaalokowany rozmiar tablicy zdarzen.
+*/
+static size_t events_size = 0;
+
+/**
+Blokada chroniaca tablice zdarzen.
+*/
+static pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+Liczba watków, którym nadano juz numery w sladzie.
+*/
+static atomic_uint num_threads = 0;
+
+/**
+Numer biezacego watku w sladzie lub 0, jesli jeszcze go nie nadano.
+*/
+static _Thread_local unsigned int thread_id = 0;
+
+void StatsStart(const char* path)
+{
+    enabled = true;
+    trace_path = path;
+    trace_origin = StatsNow();
+}
+
+bool StatsEnabled(void)
+{
+    return enabled;
+}
+
+uint64_t StatsNow(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec;
+}
+
+/**
+* Wyznacza przedzial histogramu dla czasu wywolania.
+* @param[in] ns: czas w nanosekundach
+* @return numer przedzialu
+*/
+static size_t Bucket(uint64_t ns)
+{
+    size_t bucket = 0;
+    while (ns > 1 && bucket + 1 < STATS_BUCKETS)
+    {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+* Dopisuje zdarzenie do sladu.
+* @param[in] e: zdarzenie
+*/
+static void TraceAppend(TraceEvent e)
+{
+    pthread_mutex_lock(&events_lock);
+    if (num_events == events_size)
+    {
+        events_size = (events_size == 0) ? 1024 : 2 * events_size;
+        events = realloc(events, events_size * sizeof(TraceEvent));
+        CHECK_PTR(events);
+    }
+    events[num_events++] = e;
+    pthread_mutex_unlock(&events_lock);
+}
+
+void StatsRecord(Stats* s, uint64_t start, unsigned int num_of_lines)
+{
+    uint64_t duration = StatsNow() - start;
+    atomic_fetch_add_explicit(&s->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->total_ns, duration, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->buckets[Bucket(duration)], 1, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&s->max_ns, memory_order_relaxed);
+    while (duration > max
+           && !atomic_compare_exchange_weak_explicit(&s->max_ns, &max, duration,
+                                                     memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+
+    if (trace_path != NULL)
+    {
+        if (thread_id == 0)
+        {
+            thread_id = atomic_fetch_add(&num_threads, 1) + 1;
+        }
+        TraceAppend((TraceEvent) {
+            .name = s->name, .start = start, .duration = duration,
+            .thread = thread_id, .num_of_lines = num_of_lines});
+    }
+}
+
+uint64_t StatsBucketBound(size_t bucket)
+{
+    return (uint64_t)2 << bucket;
+}
+
+uint64_t StatsQuantileBound(Stats* s, double q)
+{
+    size_t count = atomic_load(&s->count);
+    size_t rank = (size_t)(q * count + 0.5);
+    rank = (rank == 0) ? 1 : rank;
+    size_t seen = 0;
+    for (size_t k = 0; k < STATS_BUCKETS; k++)
+    {
+        seen += atomic_load(&s->buckets[k]);
+        if (seen >= rank)
+        {
+            return StatsBucketBound(k);
+        }
+    }
+    return StatsBucketBound(STATS_BUCKETS - 1);
+}
+
+bool StatsFinish(void)
+{
+    bool correct = true;
+    if (trace_path != NULL)
+    {
+        FILE* f = fopen(trace_path, "w");
+        correct = (f != NULL);
+        if (correct)
+        {
+            fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+            for (size_t i = 0; i < num_events; i++)
+            {
+                TraceEvent* e = &events[i];
+                fprintf(f, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                        "\"ts\": %.3f, \"dur\": %.3f, \"args\": {\"line\": %u}}",
+                        (i == 0) ? "" : ",", e->name, e->thread,
+                        (e->start - trace_origin) / 1e3, e->duration / 1e3, e->num_of_lines);
+            }
+            fprintf(f, "\n]}\n");
+            correct = (fclose(f) == 0);
+        }
+    }
+    free(events);
+    events = NULL;
+    num_events = events_size = 0;
+    enabled = false;
+    trace_path = NULL;
+    return correct;
+}
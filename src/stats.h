@@ -0,0 +1,83 @@
+/** @file
+  Interfejs statystyk czasu wykonania polecen kalkulatora:
+  liczby wywolan, histogramów czasów w skali logarytmicznej
+  i opcjonalnego sladu w formacie Chrome trace event.
+  @authors Jagoda Bracha <jb429153@students.mimuw.edu.pl>
+  @date 2021
+*/
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+Liczba przedzialów histogramu. Przedzial k obejmuje czasy
+z zakresu [2^k, 2^(k+1)) nanosekund; ostatni takze wszystkie dluzsze.
+*/
+#define STATS_BUCKETS 40
+
+/**
+* Statystyki jednego rodzaju polecen. Moga byc aktualizowane
+* jednoczesnie z wielu watków.
+*/
+typedef struct
+{
+    const char* name; ///< nazwa w podsumowaniu i w sladzie
+    atomic_size_t count; ///< liczba wywolan
+    atomic_uint_least64_t total_ns; ///< laczny czas wywolan
+    atomic_uint_least64_t max_ns; ///< najdluzszy czas wywolania
+    atomic_size_t buckets[STATS_BUCKETS]; ///< histogram czasów
+}   Stats;
+
+/**
+* Wlacza zbieranie statystyk.
+* @param[in] trace_path: plik, do którego StatsFinish zapisze slad,
+* lub NULL, jesli slad nie jest potrzebny
+*/
+void StatsStart(const char* trace_path);
+
+/**
+* Sprawdza, czy statystyki sa zbierane.
+* @return bool
+*/
+bool StatsEnabled(void);
+
+/**
+* Zwraca biezacy czas monotoniczny.
+* @return czas w nanosekundach
+*/
+uint64_t StatsNow(void);
+
+/**
+* Odnotowuje wywolanie trwajace od chwili start do teraz.
+* @param[in] s: statystyki rodzaju polecenia
+* @param[in] start: chwila rozpoczecia zwrócona przez StatsNow
+* @param[in] num_of_lines: numer linijki, zapisywany w sladzie
+*/
+void StatsRecord(Stats* s, uint64_t start, unsigned int num_of_lines);
+
+/**
+* Zwraca górna granice przedzialu histogramu.
+* @param[in] bucket: numer przedzialu
+* @return granica w nanosekundach
+*/
+uint64_t StatsBucketBound(size_t bucket);
+
+/**
+* Szacuje kwantyl czasu wywolania z histogramu.
+* @param[in] s: statystyki
+* @param[in] q: rzad kwantyla z przedzialu (0, 1]
+* @return górna granica przedzialu zawierajacego kwantyl, w nanosekundach
+*/
+uint64_t StatsQuantileBound(Stats* s, double q);
+
+/**
+* Konczy zbieranie statystyk i zapisuje slad, jesli byl zbierany.
+* @return czy udalo sie zapisac slad
+*/
+bool StatsFinish(void);
+
+#endif /* __STATS_H__ */